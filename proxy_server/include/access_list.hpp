@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+// Allow/deny rules for client networks, matched by longest prefix.
+//
+// Prefixes live in a path-compressed binary radix tree keyed on 128-bit
+// addresses; IPv4 is stored as IPv4-mapped IPv6, so one tree serves both.
+// Only nodes where prefixes branch or end exist, and compact() lays them
+// out breadth-first so the top of the tree shares cache lines.
+//
+// When any allow rule exists, unmatched clients are denied; otherwise they
+// are allowed. Build the list before the server starts: lookups take no locks.
+class AccessList {
+public:
+    enum class Action : int8_t { NONE = -1, DENY = 0, ALLOW = 1 };
+
+    // "10.0.0.0/8", "2001:db8::/32", or a bare address for a single host
+    bool add(const std::string& cidr, Action action);
+    // One "allow <cidr>" or "deny <cidr>" per line; '#' starts a comment
+    bool load_file(const std::string& path);
+    void compact();
+
+    bool allows(const struct sockaddr_storage& address) const;
+    bool allows(const std::string& address) const;
+    size_t size() const { return prefix_count_; }
+    bool empty() const { return prefix_count_ == 0; }
+
+private:
+    struct Key {
+        uint64_t high;
+        uint64_t low;
+    };
+
+    struct Node {
+        Key key;          // host bits cleared
+        uint8_t length;
+        Action action;
+        int32_t child[2];
+    };
+
+    static bool parse_address(const std::string& text, Key& key, int& max_length);
+    bool lookup(const Key& key) const;
+    void insert(Key key, int length, Action action);
+    int32_t new_node(const Key& key, int length, Action action);
+
+    std::vector<Node> nodes_;
+    int32_t root_ = -1;
+    size_t prefix_count_ = 0;
+    size_t allow_count_ = 0;
+};
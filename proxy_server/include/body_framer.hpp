@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Finds the end of an HTTP/1.1 request body while it is relayed verbatim.
+//
+// Framing comes from the head: Transfer-Encoding: chunked, Content-Length,
+// or no body at all. Chunked bodies are parsed incrementally, so a chunk
+// header split across reads is fine.
+class BodyFramer {
+public:
+    // Returns false for framing a proxy must reject: an unknown transfer
+    // coding, conflicting lengths, or both Content-Length and chunked
+    bool init(std::string_view head);
+
+    // How many of the `length` bytes belong to the body; anything after
+    // the end of the body is not counted
+    size_t consume(const char* data, size_t length);
+
+    bool done() const { return state_ == State::DONE; }
+    bool failed() const { return state_ == State::FAILED; }
+    bool chunked() const { return chunked_; }
+
+private:
+    enum class State {
+        LENGTH,         // fixed-size body, remaining_ bytes left
+        CHUNK_SIZE,
+        CHUNK_EXTENSION,
+        CHUNK_SIZE_LF,
+        CHUNK_DATA,
+        CHUNK_DATA_CR,
+        CHUNK_DATA_LF,
+        TRAILER_START,
+        TRAILER_LINE,
+        TRAILER_LF,
+        FINAL_LF,
+        DONE,
+        FAILED,
+    };
+
+    State state_ = State::DONE;
+    bool chunked_ = false;
+    uint64_t remaining_ = 0;
+    int size_digits_ = 0;
+};
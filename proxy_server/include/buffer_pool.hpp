@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+
+// Size-classed I/O buffers recycled through a per-thread cache backed by a
+// shared depot, so connection buffers don't live on worker stacks.
+class BufferPool {
+public:
+    static constexpr size_t NUM_CLASSES = 4;
+    static constexpr size_t SIZE_CLASSES[NUM_CLASSES] = {2048, 8192, 32768, 131072};
+    static constexpr size_t MAX_THREAD_CACHED = 8;   // per class, per thread
+    static constexpr size_t MAX_DEPOT_CACHED = 256;  // per class, shared
+
+    class Buffer {
+    public:
+        Buffer() = default;
+        ~Buffer();
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        char* data() { return data_; }
+        const char* data() const { return data_; }
+        size_t capacity() const { return data_ ? SIZE_CLASSES[class_index_] : 0; }
+
+        // Move to the next size class, keeping the first `used` bytes.
+        // Returns false when already at the largest class.
+        bool grow(size_t used = 0);
+        // Drop back to the smallest class if `used` bytes still fit.
+        void shrink(size_t used = 0);
+
+    private:
+        friend class BufferPool;
+        Buffer(char* data, size_t class_index) : data_(data), class_index_(class_index) {}
+        void resize_to(size_t class_index, size_t used);
+
+        char* data_ = nullptr;
+        size_t class_index_ = 0;
+    };
+
+    struct Stats {
+        size_t buffers_in_use;
+        size_t bytes_in_use;
+        size_t buffers_cached;
+        size_t bytes_cached;
+    };
+
+    // Returns a buffer of the smallest class holding at least `min_size` bytes
+    // (the largest class if none does).
+    static Buffer acquire(size_t min_size);
+    static Stats stats();
+
+private:
+    static size_t class_for(size_t min_size);
+    static char* allocate(size_t class_index);
+    static void release(char* data, size_t class_index);
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "traffic_capture.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Replays a traffic capture against a proxy pointed at a local synthetic
+// origin. Each request asks the origin for its captured response size.
+// CONNECT tunnels and chunked uploads are skipped: the capture keeps
+// neither the tunnel bytes nor the chunk layout.
+class CaptureReplay {
+public:
+    static constexpr const char* RESPONSE_SIZE_HEADER = "X-Replay-Response-Bytes";
+
+    struct Endpoint {
+        std::string host;
+        std::string port;
+    };
+
+    struct Report {
+        size_t requests = 0;
+        size_t errors = 0;
+        double seconds = 0;
+        uint64_t bytes = 0;       // received, heads included
+        uint64_t body_bytes = 0;  // request bodies sent
+        std::vector<double> latencies_ms;  // successful requests, sorted
+
+        double percentile(double p) const;
+        double requests_per_second() const { return seconds > 0 ? requests / seconds : 0; }
+        double megabytes_per_second() const { return seconds > 0 ? bytes / seconds / 1e6 : 0; }
+    };
+
+    // "<host>:<port>"
+    static bool parse_endpoint(const std::string& text, Endpoint& endpoint);
+    static bool is_connect(const TrafficCapture::Record& record);
+    static bool is_chunked(const TrafficCapture::Record& record);
+    static bool is_replayable(const TrafficCapture::Record& record) {
+        return !is_connect(record) && !is_chunked(record);
+    }
+
+    // Sends the requests in arrival order, `speed` times faster than captured
+    static Report run(const std::vector<TrafficCapture::Record>& records, const Endpoint& proxy,
+                      double speed, size_t concurrency);
+};
@@ -3,23 +3,103 @@
 #include <string>
 #include <set>
 #include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <string_view>
+#include "url_matcher.hpp"
 
 class FilterManager {
 public:
+    static constexpr std::chrono::milliseconds SNAPSHOT_DEBOUNCE{200};
+
+    struct BatchResult {
+        size_t added;
+        size_t removed;
+        size_t total;  // list size after the batch
+    };
+
+    // Prefix matches are counted up to this many, so a page costs the same
+    // however large the list is
+    static constexpr size_t MAX_COUNTED_MATCHES = 1000;
+
+    struct BlacklistPage {
+        std::vector<std::string> entries;
+        size_t total;        // entries starting with the prefix
+        bool total_capped;   // more than MAX_COUNTED_MATCHES match; total is the cap
+        bool has_more;       // more entries match after the last one returned
+    };
+
     FilterManager();
-    ~FilterManager() = default;
+    ~FilterManager();
 
     // Blacklist management
     void add_blacklist_entry(const std::string& entry);
     void remove_blacklist_entry(const std::string& entry);
-    const std::set<std::string>& get_blacklist() const { return blacklist_; }
+    std::set<std::string> get_blacklist() const;
+    // Batched updates take the lock once and write one snapshot; they return
+    // how many entries changed
+    BatchResult apply_blacklist_batch(const std::vector<std::string>& adds, const std::vector<std::string>& removes);
+    size_t add_blacklist_entries(const std::vector<std::string>& entries);
+    size_t remove_blacklist_entries(const std::vector<std::string>& entries);
+    // Up to `limit` entries starting with `prefix` and sorted after `after`
+    BlacklistPage get_blacklist_page(const std::string& prefix, const std::string& after, size_t limit) const;
+    size_t blacklist_size() const;
     void set_blacklist_mode(bool enabled);
     bool is_blacklist_mode() const { return blacklist_mode_; }
 
     // Check if a URL is blocked
     bool is_blocked(const std::string& url) const;
 
+    // URL rules match anywhere in the request target (see UrlMatcher). Each
+    // change compiles a new automaton on the caller's thread and swaps it in,
+    // so lookups never wait for a rebuild. A batch compiles once.
+    BatchResult apply_url_rule_batch(const std::vector<std::string>& adds, const std::vector<std::string>& removes);
+    bool add_url_rule(const std::string& rule);
+    bool remove_url_rule(const std::string& rule);
+    std::vector<std::string> get_url_rules() const;
+    // Returns the matching rule, or an empty string
+    std::string match_url_rule(std::string_view url) const;
+    // For the request path: matches `pieces` as one URL without joining
+    // them, and copies the rule into `rule` only on a match
+    bool match_url_rule(std::initializer_list<std::string_view> pieces, std::string& rule) const;
+
+    // Snapshot persistence: loads `path` if it exists, then rewrites it in the
+    // background after every change
+    bool enable_persistence(const std::string& path);
+    bool save_snapshot();
+    bool reload_snapshot();
+    // Asks the background writer to reload the snapshot file; false when
+    // persistence is not enabled
+    bool request_reload();
+    // Blocks until queued snapshot writes and reloads are done; false on timeout
+    bool wait_for_persistence(std::chrono::milliseconds timeout);
+
 private:
+    void mark_dirty();
+    void persistence_loop();
+    // Caller holds rules_mutex_
+    void rebuild_url_matcher();
+
     std::set<std::string> blacklist_;
-    bool blacklist_mode_;
-}; 
\ No newline at end of file
+    std::atomic<bool> blacklist_mode_;
+    mutable std::shared_mutex mutex_;
+
+    std::set<std::string> url_rules_;
+    mutable std::mutex rules_mutex_;
+    // Read with std::atomic_load; replaced whole on every change
+    std::shared_ptr<const UrlMatcher> url_matcher_;
+
+    std::string snapshot_path_;
+    std::thread persistence_thread_;
+    std::mutex persistence_mutex_;
+    std::condition_variable persistence_cv_;
+    bool dirty_ = false;
+    bool reload_requested_ = false;
+    bool persisting_ = false;  // a write or reload runs without the lock
+    bool stopping_ = false;
+};
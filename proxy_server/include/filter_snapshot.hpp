@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+
+// Versioned binary image of the filter set, loaded through mmap.
+//
+// Layout (host byte order):
+//   Header                      magic "CXPF", version, flags, entry count, blob size
+//   uint32_t offsets[count + 1] start of each entry in the blob, plus end marker
+//   char blob[blob_size]        entries, sorted, without separators
+class FilterSnapshot {
+public:
+    static constexpr uint32_t MAGIC = 0x46505843;  // "CXPF"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t FLAG_BLACKLIST_MODE = 1u << 0;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t flags;
+        uint32_t entry_count;
+        uint64_t blob_size;
+    };
+
+    // Writes to `path` + ".tmp", fsyncs and renames over `path`, so readers
+    // only ever see a complete snapshot.
+    static bool write(const std::string& path, const std::set<std::string>& entries, bool blacklist_mode);
+
+    // Returns false if the file is missing, truncated or of another version.
+    static bool read(const std::string& path, std::set<std::string>& entries, bool& blacklist_mode);
+};
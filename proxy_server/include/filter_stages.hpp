@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include "request_filter.hpp"
+#include "filter_manager.hpp"
+
+// Request filter stages backed by the FilterManager; see request_filter.hpp
+
+// Denies hosts on the blacklist
+class HostBlacklistStage {
+public:
+    static constexpr const char* NAME = "host_blacklist";
+
+    explicit HostBlacklistStage(const FilterManager& filter_manager) : filter_manager_(&filter_manager) {}
+
+    FilterVerdict check(const RequestView& request, FilterResult& result) const {
+        std::string host(request.host);
+        if (!filter_manager_->is_blocked(host)) {
+            return FilterVerdict::ALLOW;
+        }
+        return result.deny("403 Forbidden", "host in blacklist: " + host);
+    }
+
+private:
+    const FilterManager* filter_manager_;
+};
+
+// Denies URLs matching a path or keyword rule; CONNECT requests only
+// expose the host, which the blacklist already covers
+class UrlRuleStage {
+public:
+    static constexpr const char* NAME = "url_rules";
+
+    explicit UrlRuleStage(const FilterManager& filter_manager) : filter_manager_(&filter_manager) {}
+
+    FilterVerdict check(const RequestView& request, FilterResult& result) const {
+        if (request.is_connect()) {
+            return FilterVerdict::ALLOW;
+        }
+        // Origin-form targets are matched as the absolute URL, in pieces so
+        // that allowed requests never allocate
+        std::string rule;
+        bool matched = !request.target.empty() && request.target.front() == '/'
+            ? filter_manager_->match_url_rule({"http://", request.authority, request.target}, rule)
+            : filter_manager_->match_url_rule({request.target}, rule);
+        if (!matched) {
+            return FilterVerdict::ALLOW;
+        }
+        return result.deny("403 Forbidden", std::string(request.target) + " matches URL rule: " + rule);
+    }
+
+private:
+    const FilterManager* filter_manager_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/uio.h>
+
+// Rewrites an HTTP request head for forwarding without copying it.
+//
+// The outgoing request is described as a list of slices: ranges of the
+// original buffer plus a few inserted fields, sent with a single sendmsg.
+// Hop-by-hop headers are dropped, the absolute-form target becomes
+// origin-form, and Via, X-Forwarded-For and Connection: close are added.
+class HeaderRewriter {
+public:
+    static constexpr const char* VIA_PSEUDONYM = "cxx_proxy";
+
+    struct Options {
+        // Parent proxies need the absolute-form target to route the request
+        bool keep_absolute_form = false;
+        std::string_view client_address;
+        // Edits from request filters: complete lines ending in CRLF, and
+        // names of fields to drop
+        std::string_view added_fields;
+        const std::vector<std::string>* removed_fields = nullptr;
+    };
+
+    // `request` holds the complete head and any body bytes read with it; the
+    // slices point into it, so it must outlive send(). Returns false if the
+    // head is incomplete or malformed, or if its Connection field names
+    // Content-Length, Transfer-Encoding or Host: those are never dropped.
+    bool rewrite(std::string_view request, const Options& options);
+
+    const std::vector<struct iovec>& slices() const { return slices_; }
+    size_t size() const;
+    bool send(int socket) const;
+
+private:
+    struct Slice {
+        bool inserted;
+        size_t offset;
+        size_t length;
+    };
+
+    void add_original(size_t offset, size_t length);
+    void add_inserted(std::string_view text);
+
+    std::string_view request_;
+    std::string inserted_;
+    std::vector<Slice> layout_;
+    std::vector<struct iovec> slices_;
+};
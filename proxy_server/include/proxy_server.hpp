@@ -1,18 +1,35 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <vector>
 #include <functional>
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include "filter_manager.hpp"
+#include "rate_limiter.hpp"
+#include "upstream_pool.hpp"
+#include "traffic_capture.hpp"
+#include "socket_profile.hpp"
+#include "access_list.hpp"
+#include "buffer_pool.hpp"
+#include "body_framer.hpp"
+#include "filter_stages.hpp"
 
 class ProxyServer {
 public:
     static constexpr int BUFFER_SIZE = 8192;
     static constexpr int MAX_CONNECTIONS = 100;
+    static constexpr int TUNNEL_IDLE_SHRINK_SECONDS = 5;
+    static constexpr int ACCEPT_POLL_MS = 250;
+    static constexpr int ACCEPT_BACKOFF_MIN_MS = 10;
+    static constexpr size_t MAX_HEAD_SIZE = 32768;
+    static constexpr int HEAD_TIMEOUT_MS = 10000;
 
     ProxyServer(uint16_t port, FilterManager& filter_manager);
     ~ProxyServer();
@@ -21,19 +38,84 @@ public:
     void stop();
     bool is_running() const;
 
+    // Graceful upgrade: accept on a listening socket inherited from another
+    // process, or stop accepting and let in-flight connections finish
+    bool open_listener();
+    void adopt_listener(int listener);
+    int listener() const { return server_socket_; }
+    void stop_accepting();
+    void drain(std::chrono::milliseconds timeout);
+
+    // Optional per-client limits; must be set before start()
+    void set_rate_limiter(RateLimiter* rate_limiter) { rate_limiter_ = rate_limiter; }
+    // Optional parent proxies; when set, every request is routed through them
+    void set_upstream_pool(UpstreamPool* upstream_pool) { upstream_pool_ = upstream_pool; }
+    // Optional capture of sampled requests for replay
+    void set_traffic_capture(TrafficCapture* capture) { capture_ = capture; }
+    // TCP options for the listener, client and upstream sockets; set before start()
+    void set_socket_profile(const SocketProfile& profile) { socket_profile_ = profile; }
+    // Optional client network filter, checked before any work on a new connection
+    void set_access_list(const AccessList* access_list) { access_list_ = access_list; }
+    // Time a client gets to send its whole request head; set before start()
+    void set_head_timeout(std::chrono::milliseconds timeout) { head_timeout_ = timeout; }
+
+    // Per-stage counters of the request filter chain; empty unless built
+    // with PROXY_FILTER_STATS
+    std::vector<FilterStageStats> filter_stats() const { return request_filters_.stats(); }
+
 private:
-    void handle_connection(int client_socket);
+    // Policy applied to every parsed request, in order
+    using RequestFilters = FilterChain<HostBlacklistStage, UrlRuleStage>;
+
+    struct Connection {
+        uint64_t id;
+        int socket;
+        std::string client_address;
+        RateLimiter::Lease lease;
+
+        // Filled in for sampled connections only
+        bool sampled = false;
+        TrafficCapture::Record capture;
+    };
+
+    void run_connection(Connection connection);
+    void handle_connection(Connection& connection);
     void accept_connections();
     bool initialize_socket();
-    int create_target_connection(const std::string& host, int port);
-    void tunnel_connection(int client_socket, int target_socket);
-    void send_error_response(int socket, const std::string& status);
-    std::string extract_host_from_request(const std::string& request);
+    // Fast Open is only used where the first write, not connect(), is
+    // trusted to tell that the peer is reachable
+    int connect_upstream(const std::string& host, int port, UpstreamPool::Lease& parent, bool fast_open);
+    int create_target_connection(const std::string& host, int port, bool fast_open);
+    static constexpr long HEAD_TOO_LARGE = -1;
+    static constexpr long HEAD_TIMED_OUT = -2;
+    // Reads until the blank line ending the head. Returns the head size, 0 if
+    // the client went away, HEAD_TOO_LARGE past MAX_HEAD_SIZE, or
+    // HEAD_TIMED_OUT if the head is not complete within the head timeout.
+    long read_request_head(int socket, BufferPool::Buffer& buffer, size_t& received);
+    // Streams the rest of the request body upstream while relaying the response
+    void relay_request(Connection& connection, int target_socket, BodyFramer& body);
+    void tunnel_connection(Connection& connection, int target_socket);
+    // Counts relayed bytes for capture and applies bandwidth limits
+    void account_relayed(Connection& connection, size_t bytes, bool to_client);
+    void send_error_response(int socket, const char* status);
+    void log_filter_stats() const;
+    std::string extract_host_from_request(std::string_view request);
 
     uint16_t port_;
     int server_socket_;
     std::atomic<bool> running_;
+    std::atomic<bool> accepting_{false};
     std::vector<std::thread> worker_threads_;
     std::mutex mutex_;
+    std::condition_variable drained_cv_;
+    std::map<uint64_t, int> active_connections_;  // id -> client socket, guarded by mutex_
+    uint64_t next_connection_id_ = 0;
     FilterManager& filter_manager_;
+    RequestFilters request_filters_;
+    RateLimiter* rate_limiter_ = nullptr;
+    UpstreamPool* upstream_pool_ = nullptr;
+    TrafficCapture* capture_ = nullptr;
+    SocketProfile socket_profile_;
+    const AccessList* access_list_ = nullptr;
+    std::chrono::milliseconds head_timeout_{HEAD_TIMEOUT_MS};
 }; 
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Lock-free token bucket. Tokens are kept in thousandths so fractional
+// refills are not lost between calls.
+class TokenBucket {
+public:
+    TokenBucket() = default;
+    // A zero burst defaults to one second of rate
+    void configure(double rate_per_second, double burst);
+
+    bool unlimited() const { return rate_ <= 0; }
+    // Takes `amount` tokens if they are all available
+    bool try_consume(double amount, int64_t now_ns);
+    // Always takes `amount`, going into debt if needed, and returns how long
+    // the caller should wait for the balance to recover
+    std::chrono::nanoseconds consume(double amount, int64_t now_ns);
+    // Infinite for unlimited buckets
+    double available(int64_t now_ns);
+
+private:
+    void refill(int64_t now_ns);
+
+    double rate_ = 0;
+    int64_t capacity_ = 0;
+    std::atomic<int64_t> tokens_{0};
+    std::atomic<int64_t> last_refill_ns_{0};
+};
+
+// Per-client-IP request, connection and bandwidth limits.
+class RateLimiter {
+public:
+    static constexpr size_t NUM_SHARDS = 64;
+    static constexpr size_t EVICTION_INTERVAL = 1024;  // lookups per shard sweep
+
+    // Zero disables a limit; a zero burst means one second of its rate
+    struct Config {
+        double requests_per_second = 0;
+        double request_burst = 0;
+        int max_connections = 0;
+        double bytes_per_second = 0;
+        double byte_burst = 0;
+        std::chrono::seconds idle_timeout{60};
+    };
+
+    struct ClientState {
+        TokenBucket requests;
+        TokenBucket bytes;
+        std::atomic<int> connections{0};
+        std::atomic<int64_t> last_seen_ns{0};
+    };
+
+    struct ClientSnapshot {
+        std::string address;
+        int connections;
+        double request_tokens;
+        double byte_tokens;
+    };
+
+    // Holds one open connection slot for a client and releases it when destroyed
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(RateLimiter* limiter, std::shared_ptr<ClientState> state)
+            : limiter_(limiter), state_(std::move(state)) {}
+        ~Lease() { release(); }
+        Lease(Lease&& other) noexcept : limiter_(other.limiter_), state_(std::move(other.state_)) {}
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                limiter_ = other.limiter_;
+                state_ = std::move(other.state_);
+            }
+            return *this;
+        }
+
+        explicit operator bool() const { return state_ != nullptr; }
+        // Charges relayed bytes and returns how long to pause before relaying more
+        std::chrono::nanoseconds charge_bytes(size_t bytes) {
+            return state_ ? limiter_->charge_bytes(*state_, bytes) : std::chrono::nanoseconds(0);
+        }
+
+    private:
+        void release() {
+            if (state_) {
+                limiter_->close_connection(*state_);
+                state_.reset();
+            }
+        }
+
+        RateLimiter* limiter_ = nullptr;
+        std::shared_ptr<ClientState> state_;
+    };
+
+    explicit RateLimiter(const Config& config);
+
+    const Config& config() const { return config_; }
+
+    // Returns an empty lease if the client is over its connection or request limit
+    Lease open_connection(const std::string& address);
+    std::shared_ptr<ClientState> client(const std::string& address);
+    // Counts a new connection and one request; false if either limit is hit
+    bool try_open_connection(ClientState& state);
+    void close_connection(ClientState& state);
+    std::chrono::nanoseconds charge_bytes(ClientState& state, size_t bytes);
+
+    void evict_idle();
+    std::vector<ClientSnapshot> snapshot() const;
+
+    static int64_t now_ns();
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<ClientState>> clients;
+        size_t lookups = 0;
+    };
+
+    void evict_idle(Shard& shard, int64_t now);
+
+    Config config_;
+    std::array<Shard, NUM_SHARDS> shards_;
+};
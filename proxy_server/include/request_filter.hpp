@@ -0,0 +1,191 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <strings.h>
+
+// Per-request policy as a chain of stages composed at compile time.
+//
+// A stage is any type with a NAME and a const check() method:
+//
+//     struct DenyPosts {
+//         static constexpr const char* NAME = "deny_posts";
+//         FilterVerdict check(const RequestView& request, FilterResult& result) const;
+//     };
+//
+// FilterChain<A, B, C> calls the stages in order through a fold over a
+// tuple, so there is no virtual dispatch and the checks inline into the
+// caller. Stages are shared by every connection thread and must not
+// mutate themselves. Building with PROXY_FILTER_STATS adds per-stage call,
+// verdict and time counters.
+
+// The parsed request a stage inspects. The fields are views into buffers
+// owned by the connection thread (the request head, the parsed target and
+// host, the client address), so a RequestView is only valid for the
+// duration of FilterChain::run(); stages must copy anything they keep.
+struct RequestView {
+    std::string_view method;
+    std::string_view target;
+    std::string_view authority;  // host[:port] as the client sent it
+    std::string_view host;
+    uint16_t port = 0;
+    std::string_view head;
+    std::string_view client_address;
+
+    bool is_connect() const { return method == "CONNECT"; }
+
+    // Value of the first field called `name`, trimmed; empty if absent
+    std::string_view header(std::string_view name) const {
+        size_t start = head.find("\r\n");
+        while (start != std::string_view::npos && start + 2 < head.size()) {
+            start += 2;
+            size_t end = head.find("\r\n", start);
+            std::string_view line = head.substr(start, end - start);
+            start = end;
+            if (line.size() > name.size() && line[name.size()] == ':' &&
+                strncasecmp(line.data(), name.data(), name.size()) == 0) {
+                std::string_view value = line.substr(name.size() + 1);
+                while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+                    value.remove_prefix(1);
+                }
+                while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+                    value.remove_suffix(1);
+                }
+                return value;
+            }
+        }
+        return {};
+    }
+};
+
+enum class FilterVerdict {
+    ALLOW,   // no objection, continue with the next stage
+    DENY,    // stop and answer with FilterResult::status
+    MODIFY,  // edited the FilterResult, continue with the next stage
+};
+
+// Outcome of a chain run
+struct FilterResult {
+    FilterVerdict verdict = FilterVerdict::ALLOW;
+
+    // Filled in by the denying stage
+    const char* status = "403 Forbidden";
+    std::string reason;
+
+    // Header edits from modifying stages, applied when the head is
+    // forwarded; CONNECT tunnels have no head to edit
+    std::string added_fields;
+    std::vector<std::string> removed_fields;
+
+    FilterVerdict deny(const char* deny_status, std::string deny_reason) {
+        status = deny_status;
+        reason = std::move(deny_reason);
+        return FilterVerdict::DENY;
+    }
+
+    FilterVerdict add_field(std::string_view name, std::string_view value) {
+        added_fields.append(name).append(": ").append(value).append("\r\n");
+        return FilterVerdict::MODIFY;
+    }
+
+    FilterVerdict remove_field(std::string_view name) {
+        removed_fields.emplace_back(name);
+        return FilterVerdict::MODIFY;
+    }
+};
+
+struct FilterStageStats {
+    const char* name;
+    uint64_t calls;
+    uint64_t denials;
+    uint64_t modifications;
+    uint64_t nanoseconds;
+};
+
+template <typename... Stages>
+class FilterChain {
+public:
+#ifdef PROXY_FILTER_STATS
+    static constexpr bool INSTRUMENTED = true;
+#else
+    static constexpr bool INSTRUMENTED = false;
+#endif
+    static constexpr size_t STAGE_COUNT = sizeof...(Stages);
+
+    explicit FilterChain(Stages... stages) : stages_(std::move(stages)...) {}
+
+    // Runs the stages in order, stopping at the first denial
+    FilterResult run(const RequestView& request) const {
+        FilterResult result;
+        run_stages(request, result, std::index_sequence_for<Stages...>{});
+        return result;
+    }
+
+    // Counters per stage in chain order; empty unless INSTRUMENTED
+    std::vector<FilterStageStats> stats() const {
+        std::vector<FilterStageStats> stats;
+#ifdef PROXY_FILTER_STATS
+        const char* names[] = {Stages::NAME..., nullptr};
+        for (size_t i = 0; i < STAGE_COUNT; ++i) {
+            const Counters& counters = counters_[i];
+            stats.push_back({names[i],
+                             counters.calls.load(std::memory_order_relaxed),
+                             counters.denials.load(std::memory_order_relaxed),
+                             counters.modifications.load(std::memory_order_relaxed),
+                             counters.nanoseconds.load(std::memory_order_relaxed)});
+        }
+#endif
+        return stats;
+    }
+
+private:
+    template <size_t... Index>
+    void run_stages(const RequestView& request, FilterResult& result, std::index_sequence<Index...>) const {
+        // && stops the fold at the first stage that returns false
+        (void)(run_stage<Index>(request, result) && ...);
+    }
+
+    template <size_t Index>
+    bool run_stage(const RequestView& request, FilterResult& result) const {
+#ifdef PROXY_FILTER_STATS
+        auto started = std::chrono::steady_clock::now();
+#endif
+        FilterVerdict verdict = std::get<Index>(stages_).check(request, result);
+#ifdef PROXY_FILTER_STATS
+        Counters& counters = counters_[Index];
+        counters.calls.fetch_add(1, std::memory_order_relaxed);
+        counters.denials.fetch_add(verdict == FilterVerdict::DENY, std::memory_order_relaxed);
+        counters.modifications.fetch_add(verdict == FilterVerdict::MODIFY, std::memory_order_relaxed);
+        counters.nanoseconds.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count(),
+            std::memory_order_relaxed);
+#endif
+        if (verdict == FilterVerdict::DENY) {
+            result.verdict = FilterVerdict::DENY;
+            return false;
+        }
+        if (verdict == FilterVerdict::MODIFY) {
+            result.verdict = FilterVerdict::MODIFY;
+        }
+        return true;
+    }
+
+    std::tuple<Stages...> stages_;
+
+#ifdef PROXY_FILTER_STATS
+    struct Counters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> denials{0};
+        std::atomic<uint64_t> modifications{0};
+        std::atomic<uint64_t> nanoseconds{0};
+    };
+    mutable std::array<Counters, sizeof...(Stages)> counters_;
+#endif
+};
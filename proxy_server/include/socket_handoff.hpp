@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Hands the listening socket from a running proxy to its replacement over a
+// Unix domain socket (SCM_RIGHTS), so upgrades never refuse connections.
+//
+// New process: take_over() receives the socket, acknowledge() once it is
+// about to accept. Old process: serve() waits for a successor and runs
+// `on_handoff` after the acknowledgement, when it should stop accepting.
+class SocketHandoff {
+public:
+    explicit SocketHandoff(const std::string& path);
+    ~SocketHandoff();
+
+    // Returns the inherited listening socket, or -1 if no process is serving `path`
+    int take_over();
+    void acknowledge();
+
+    bool serve(int listener, std::function<void()> on_handoff);
+
+    static bool send_fd(int channel, int fd);
+    static int receive_fd(int channel);
+
+private:
+    void serve_loop(int listener, std::function<void()> on_handoff);
+
+    std::string path_;
+    int control_socket_ = -1;
+    int takeover_channel_ = -1;
+    std::thread serve_thread_;
+    std::atomic<bool> stopping_{false};
+};
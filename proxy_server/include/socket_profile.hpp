@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+// Named sets of TCP options for the listener, accepted client sockets and
+// upstream sockets. Zero leaves the kernel default in place.
+//
+//   default  kernel defaults
+//   latency  small interactive requests: no Nagle, Fast Open, busy-poll
+//   bulk     large transfers: big socket buffers, Nagle left on
+struct SocketProfile {
+    std::string name = "default";
+    bool no_delay = false;
+    int fast_open_queue = 0;       // listener TCP_FASTOPEN backlog
+    bool fast_open_connect = false;
+    int defer_accept_seconds = 0;
+    int send_buffer = 0;
+    int receive_buffer = 0;
+    int not_sent_lowat = 0;
+    int busy_poll_us = 0;
+
+    // "<name>[,key=value...]", e.g. "bulk,sndbuf=8388608". Keys: nodelay,
+    // fastopen, fastopen-connect, defer-accept, sndbuf, rcvbuf,
+    // notsent-lowat, busy-poll.
+    static bool parse(const std::string& spec, SocketProfile& profile);
+    std::string describe() const;
+
+    // Listener options must be set before listen(), upstream ones before connect().
+    // Fast Open connect makes connect() succeed before any handshake, so
+    // callers that act on its result pass allow_fast_open_connect = false.
+    void apply_listener(int socket) const;
+    void apply_client(int socket) const;
+    void apply_upstream(int socket, bool allow_fast_open_connect) const;
+};
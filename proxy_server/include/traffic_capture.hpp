@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Compact binary log of sampled requests for replaying production load shapes.
+//
+// Layout (host byte order): FileHeader, then one RecordHeader per request
+// followed by its target host and request head bytes. Headers are written
+// field by field, so the file holds no struct padding.
+class TrafficCapture {
+public:
+    static constexpr uint32_t MAGIC = 0x43505843;  // "CXPC"
+    static constexpr uint32_t VERSION = 2;
+    static constexpr size_t MAX_HEAD_SIZE = 16384;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    struct RecordHeader {
+        uint64_t offset_ns;       // arrival time since capture start
+        uint64_t request_bytes;   // client -> proxy, head included
+        uint64_t response_bytes;  // proxy -> client
+        uint64_t duration_us;
+        uint16_t port;
+        uint16_t host_size;
+        uint32_t head_size;
+    };
+    static constexpr size_t RECORD_HEADER_SIZE = 4 * sizeof(uint64_t) + 2 * sizeof(uint16_t) + sizeof(uint32_t);
+
+    struct Record {
+        uint64_t offset_ns = 0;
+        uint64_t request_bytes = 0;
+        uint64_t response_bytes = 0;
+        uint64_t duration_us = 0;
+        uint16_t port = 0;
+        std::string host;
+        std::string head;
+    };
+
+    TrafficCapture(const std::string& path, double sample_rate);
+    ~TrafficCapture();
+
+    bool is_open() const { return file_ != nullptr; }
+    bool should_sample() const;
+    // Arrival offset to store in a record for a request that arrives now
+    uint64_t offset_now() const;
+    void record(const Record& record);
+
+    static bool read_all(const std::string& path, std::vector<Record>& records);
+
+private:
+    FILE* file_;
+    double sample_rate_;
+    std::chrono::steady_clock::time_point start_;
+    std::mutex mutex_;
+};
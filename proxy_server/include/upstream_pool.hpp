@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Pool of parent proxies with load balancing and passive/active health checks.
+class UpstreamPool {
+public:
+    enum class Policy {
+        WEIGHTED,
+        LEAST_CONNECTIONS,
+        CONSISTENT_HASH
+    };
+
+    static constexpr int EJECT_AFTER_FAILURES = 3;
+    static constexpr std::chrono::seconds EJECT_DURATION{30};
+    static constexpr int HASH_POINTS_PER_WEIGHT = 100;
+    static constexpr std::chrono::milliseconds PROBE_TIMEOUT{1000};
+
+    struct Upstream {
+        std::string host;
+        int port;
+        int weight;
+        std::atomic<int> active_connections{0};
+        std::atomic<int> consecutive_failures{0};
+        std::atomic<int64_t> ejected_until_ns{0};
+        int current_weight = 0;  // smooth weighted round robin, guarded by mutex_
+    };
+
+    // Counts one connection against an upstream for as long as it is held
+    class Lease {
+    public:
+        Lease() = default;
+        explicit Lease(Upstream* upstream) : upstream_(upstream) {
+            upstream_->active_connections.fetch_add(1, std::memory_order_relaxed);
+        }
+        ~Lease() { release(); }
+        Lease(Lease&& other) noexcept : upstream_(std::exchange(other.upstream_, nullptr)) {}
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                upstream_ = std::exchange(other.upstream_, nullptr);
+            }
+            return *this;
+        }
+
+        explicit operator bool() const { return upstream_ != nullptr; }
+        Upstream* operator->() const { return upstream_; }
+        Upstream& operator*() const { return *upstream_; }
+
+    private:
+        void release() {
+            if (upstream_) {
+                upstream_->active_connections.fetch_sub(1, std::memory_order_relaxed);
+                upstream_ = nullptr;
+            }
+        }
+
+        Upstream* upstream_ = nullptr;
+    };
+
+    explicit UpstreamPool(Policy policy);
+    ~UpstreamPool();
+
+    static bool parse_policy(const std::string& name, Policy& policy);
+
+    // Upstreams must all be added before the pool is used
+    void add_upstream(const std::string& host, int port, int weight = 1);
+    size_t size() const { return upstreams_.size(); }
+    Upstream& upstream(size_t index) { return *upstreams_[index]; }
+
+    // Picks a healthy upstream for a request to `target_host`; empty if none
+    Lease select(const std::string& target_host);
+
+    void report_success(Upstream& upstream);
+    void report_failure(Upstream& upstream);
+    bool is_healthy(const Upstream& upstream) const;
+
+    // Probes every upstream with a TCP connect once per `interval`
+    void start_health_checks(std::chrono::milliseconds interval);
+    void probe_all();
+
+private:
+    Upstream* select_weighted();
+    Upstream* select_least_connections();
+    Upstream* select_consistent_hash(const std::string& target_host);
+    void build_ring();
+    void health_check_loop(std::chrono::milliseconds interval);
+
+    Policy policy_;
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    std::vector<std::pair<uint64_t, size_t>> ring_;
+    std::mutex mutex_;
+
+    std::thread health_thread_;
+    std::mutex health_mutex_;
+    std::condition_variable health_cv_;
+    bool stopping_ = false;
+};
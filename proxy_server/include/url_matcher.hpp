@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable Aho-Corasick automaton over a set of URL rules.
+//
+// A rule matches anywhere in the URL, case-insensitively. A leading '|'
+// anchors it to the start of the URL and a trailing '|' to the end, so
+// "/ads/" blocks any path containing it and "tracker.js|" only URLs
+// ending in it. All rules are checked in a single pass over the URL.
+//
+// Bytes are mapped to classes first: every byte that appears in no rule
+// shares one class, so the transition table stays narrow.
+class UrlMatcher {
+public:
+    explicit UrlMatcher(const std::vector<std::string>& rules);
+
+    // Index of a rule matching `url`, or -1
+    int find(std::string_view url) const { return find_concatenated({url}); }
+    // Same, for a URL given in pieces, so callers need not join them
+    int find_concatenated(std::initializer_list<std::string_view> pieces) const;
+    bool matches(std::string_view url) const { return find(url) >= 0; }
+
+    const std::string& rule(size_t index) const { return rules_[index].text; }
+    size_t rule_count() const { return rules_.size(); }
+    size_t state_count() const { return accept_.size(); }
+    size_t class_count() const { return class_count_; }
+
+private:
+    struct Rule {
+        std::string text;  // as given, anchors included
+        size_t length;     // without anchors
+        bool anchored_start;
+        bool anchored_end;
+    };
+
+    std::vector<Rule> rules_;
+    uint8_t byte_class_[256];
+    size_t class_count_;
+    // Bytes that leave the root state; anything else is skipped without a table lookup
+    bool starts_rule_[256];
+    std::vector<int32_t> transitions_;  // state * class_count_ + class
+    std::vector<int32_t> accept_;       // unanchored rule ending in this state, or -1
+    // Anchored rules ending in each state: anchored_rules_[anchored_begin_[s] .. anchored_begin_[s + 1])
+    std::vector<uint32_t> anchored_begin_;
+    std::vector<int32_t> anchored_rules_;
+};
@@ -1,17 +1,37 @@
 #pragma once
 
 #include "filter_manager.hpp"
+#include "rate_limiter.hpp"
 #include <httplib.h>
+#include <atomic>
 #include <string>
 
+class ProxyServer;
+
 class WebUI {
 public:
+    static constexpr size_t DEFAULT_PAGE_SIZE = 100;
+    static constexpr size_t MAX_PAGE_SIZE = 1000;
+
     WebUI(uint16_t port, FilterManager& filter_manager);
+    static constexpr int LISTEN_RETRIES = 20;
+    static constexpr int LISTEN_RETRY_MS = 250;
+    static constexpr int STOP_RETRY_MS = 10;
+
     void start();
+    void stop();
+    void set_rate_limiter(RateLimiter* rate_limiter) { rate_limiter_ = rate_limiter; }
+    // Source of request filter stage counters
+    void set_proxy_server(const ProxyServer* proxy_server) { proxy_server_ = proxy_server; }
 
 private:
     std::string generate_dashboard();
     uint16_t port_;
     FilterManager& filter_manager_;
+    RateLimiter* rate_limiter_ = nullptr;
+    const ProxyServer* proxy_server_ = nullptr;
     httplib::Server server_;
+    std::atomic<bool> started_{false};
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> finished_{false};
 }; 
\ No newline at end of file
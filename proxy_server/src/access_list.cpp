@@ -0,0 +1,267 @@
+#include "access_list.hpp"
+#include "logger.hpp"
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr int KEY_BITS = 128;
+constexpr int IPV4_MAPPED_OFFSET = 96;
+
+int bit(uint64_t high, uint64_t low, int index) {
+    return index < 64 ? (high >> (63 - index)) & 1 : (low >> (127 - index)) & 1;
+}
+
+uint64_t mask_bits(uint64_t word, int keep) {
+    if (keep <= 0) {
+        return 0;
+    }
+    return keep >= 64 ? word : word & ~(~0ull >> keep);
+}
+
+uint64_t load_be64(const unsigned char* bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+} // namespace
+
+bool AccessList::parse_address(const std::string& text, Key& key, int& max_length) {
+    unsigned char bytes[16];
+    struct in_addr v4;
+    if (inet_pton(AF_INET, text.c_str(), &v4) == 1) {
+        // ::ffff:a.b.c.d
+        key.high = 0;
+        key.low = 0xffff00000000ull | ntohl(v4.s_addr);
+        max_length = 32;
+        return true;
+    }
+    if (inet_pton(AF_INET6, text.c_str(), bytes) == 1) {
+        key.high = load_be64(bytes);
+        key.low = load_be64(bytes + 8);
+        max_length = KEY_BITS;
+        return true;
+    }
+    return false;
+}
+
+bool AccessList::add(const std::string& cidr, Action action) {
+    size_t slash = cidr.find('/');
+    Key key;
+    int max_length = 0;
+    if (!parse_address(cidr.substr(0, slash), key, max_length)) {
+        Logger::get_instance().error("Invalid address in access rule: " + cidr);
+        return false;
+    }
+
+    int length = max_length;
+    if (slash != std::string::npos) {
+        char* end = nullptr;
+        long parsed = std::strtol(cidr.c_str() + slash + 1, &end, 10);
+        if (slash + 1 == cidr.size() || *end != '\0' || parsed < 0 || parsed > max_length) {
+            Logger::get_instance().error("Invalid prefix length in access rule: " + cidr);
+            return false;
+        }
+        length = static_cast<int>(parsed);
+    }
+    if (max_length == 32) {
+        length += IPV4_MAPPED_OFFSET;
+    }
+
+    insert(key, length, action);
+    return true;
+}
+
+bool AccessList::load_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        Logger::get_instance().error("Failed to open access list: " + path);
+        return false;
+    }
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string verb, cidr, extra;
+        if (!(words >> verb)) {
+            continue;
+        }
+        bool ok = static_cast<bool>(words >> cidr) && !(words >> extra);
+        if (ok && verb == "allow") {
+            ok = add(cidr, Action::ALLOW);
+        } else if (ok && verb == "deny") {
+            ok = add(cidr, Action::DENY);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            Logger::get_instance().error("Invalid access rule at " + path + ":" + std::to_string(line_number));
+            return false;
+        }
+    }
+
+    Logger::get_instance().info("Loaded access list " + path + ": " + std::to_string(prefix_count_) + " prefixes");
+    return true;
+}
+
+int32_t AccessList::new_node(const Key& key, int length, Action action) {
+    Node node;
+    node.key = {mask_bits(key.high, length), mask_bits(key.low, length - 64)};
+    node.length = static_cast<uint8_t>(length);
+    node.action = action;
+    node.child[0] = node.child[1] = -1;
+    nodes_.push_back(node);
+    return static_cast<int32_t>(nodes_.size() - 1);
+}
+
+void AccessList::insert(Key key, int length, Action action) {
+    int32_t parent = -1;
+    int direction = 0;
+    int32_t current = root_;
+
+    while (current >= 0) {
+        const Key node_key = nodes_[current].key;
+        const int node_length = nodes_[current].length;
+
+        // Bits shared by the new prefix and this node
+        int common = KEY_BITS;
+        if (uint64_t diff = key.high ^ node_key.high) {
+            common = __builtin_clzll(diff);
+        } else if (uint64_t diff = key.low ^ node_key.low) {
+            common = 64 + __builtin_clzll(diff);
+        }
+        common = std::min({common, length, node_length});
+
+        if (common == node_length && common == length) {
+            if (nodes_[current].action == Action::NONE) {
+                prefix_count_++;
+            } else if (nodes_[current].action == Action::ALLOW) {
+                allow_count_--;
+            }
+            nodes_[current].action = action;
+            allow_count_ += action == Action::ALLOW;
+            return;
+        }
+
+        if (common == node_length) {
+            // This node covers the new prefix; descend
+            parent = current;
+            direction = bit(key.high, key.low, node_length);
+            current = nodes_[current].child[direction];
+            continue;
+        }
+
+        // Split: the new prefix covers this node, or the two diverge and
+        // need an interior node at the first differing bit
+        int32_t replacement;
+        if (common == length) {
+            replacement = new_node(key, length, action);
+            nodes_[replacement].child[bit(node_key.high, node_key.low, length)] = current;
+        } else {
+            replacement = new_node(key, common, Action::NONE);
+            int32_t leaf = new_node(key, length, action);
+            nodes_[replacement].child[bit(key.high, key.low, common)] = leaf;
+            nodes_[replacement].child[bit(node_key.high, node_key.low, common)] = current;
+        }
+        if (parent < 0) {
+            root_ = replacement;
+        } else {
+            nodes_[parent].child[direction] = replacement;
+        }
+        prefix_count_++;
+        allow_count_ += action == Action::ALLOW;
+        return;
+    }
+
+    int32_t leaf = new_node(key, length, action);
+    if (parent < 0) {
+        root_ = leaf;
+    } else {
+        nodes_[parent].child[direction] = leaf;
+    }
+    prefix_count_++;
+    allow_count_ += action == Action::ALLOW;
+}
+
+void AccessList::compact() {
+    if (root_ < 0) {
+        return;
+    }
+
+    std::vector<Node> ordered;
+    ordered.reserve(nodes_.size());
+    ordered.push_back(nodes_[root_]);
+    for (size_t i = 0; i < ordered.size(); ++i) {
+        for (int32_t& child : ordered[i].child) {
+            if (child >= 0) {
+                ordered.push_back(nodes_[child]);
+                child = static_cast<int32_t>(ordered.size() - 1);
+            }
+        }
+    }
+    nodes_.swap(ordered);
+    root_ = 0;
+}
+
+bool AccessList::lookup(const Key& key) const {
+    Action result = Action::NONE;
+    int32_t current = root_;
+    while (current >= 0) {
+        const Node& node = nodes_[current];
+        int length = node.length;
+        if (mask_bits(key.high, length) != node.key.high || mask_bits(key.low, length - 64) != node.key.low) {
+            break;
+        }
+        if (node.action != Action::NONE) {
+            result = node.action;
+        }
+        if (length == KEY_BITS) {
+            break;
+        }
+        current = node.child[bit(key.high, key.low, length)];
+    }
+
+    if (result == Action::NONE) {
+        return allow_count_ == 0;
+    }
+    return result == Action::ALLOW;
+}
+
+bool AccessList::allows(const struct sockaddr_storage& address) const {
+    if (root_ < 0) {
+        return true;
+    }
+
+    Key key;
+    if (address.ss_family == AF_INET) {
+        const struct sockaddr_in* v4 = reinterpret_cast<const struct sockaddr_in*>(&address);
+        key.high = 0;
+        key.low = 0xffff00000000ull | ntohl(v4->sin_addr.s_addr);
+    } else if (address.ss_family == AF_INET6) {
+        const struct sockaddr_in6* v6 = reinterpret_cast<const struct sockaddr_in6*>(&address);
+        key.high = load_be64(v6->sin6_addr.s6_addr);
+        key.low = load_be64(v6->sin6_addr.s6_addr + 8);
+    } else {
+        return allow_count_ == 0;
+    }
+    return lookup(key);
+}
+
+bool AccessList::allows(const std::string& address) const {
+    Key key;
+    int max_length = 0;
+    if (!parse_address(address, key, max_length)) {
+        return false;
+    }
+    return root_ < 0 || lookup(key);
+}
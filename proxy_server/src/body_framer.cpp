@@ -0,0 +1,171 @@
+#include "body_framer.hpp"
+#include <strings.h>
+
+namespace {
+
+// Beyond this a chunk size would overflow 64 bits
+constexpr int MAX_CHUNK_SIZE_DIGITS = 15;
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+bool BodyFramer::init(std::string_view head) {
+    chunked_ = false;
+    remaining_ = 0;
+    size_digits_ = 0;
+    bool has_length = false;
+    bool has_transfer_encoding = false;
+
+    size_t start = head.find("\r\n");
+    while (start != std::string_view::npos && start + 2 < head.size()) {
+        start += 2;
+        size_t end = head.find("\r\n", start);
+        std::string_view line = head.substr(start, end - start);
+        start = end;
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view name = line.substr(0, colon);
+        std::string_view value = trim(line.substr(colon + 1));
+
+        if (iequals(name, "Transfer-Encoding")) {
+            has_transfer_encoding = true;
+            // chunked must be the final coding of a request
+            size_t comma = value.rfind(',');
+            chunked_ = iequals(trim(comma == std::string_view::npos ? value : value.substr(comma + 1)), "chunked");
+        } else if (iequals(name, "Content-Length")) {
+            uint64_t length = 0;
+            if (value.empty() || value.size() > 18) {
+                state_ = State::FAILED;
+                return false;
+            }
+            for (char c : value) {
+                if (c < '0' || c > '9') {
+                    state_ = State::FAILED;
+                    return false;
+                }
+                length = length * 10 + (c - '0');
+            }
+            if (has_length && length != remaining_) {
+                state_ = State::FAILED;
+                return false;
+            }
+            has_length = true;
+            remaining_ = length;
+        }
+    }
+
+    // Both framings at once is how requests get smuggled past a proxy
+    if (has_transfer_encoding && (!chunked_ || has_length)) {
+        state_ = State::FAILED;
+        return false;
+    }
+
+    if (chunked_) {
+        state_ = State::CHUNK_SIZE;
+    } else {
+        state_ = remaining_ > 0 ? State::LENGTH : State::DONE;
+    }
+    return true;
+}
+
+size_t BodyFramer::consume(const char* data, size_t length) {
+    size_t used = 0;
+    while (used < length && state_ != State::DONE && state_ != State::FAILED) {
+        char c = data[used];
+        switch (state_) {
+            case State::LENGTH: {
+                size_t take = remaining_ < length - used ? remaining_ : length - used;
+                used += take;
+                remaining_ -= take;
+                if (remaining_ == 0) {
+                    state_ = State::DONE;
+                }
+                continue;
+            }
+            case State::CHUNK_SIZE: {
+                int digit = hex_value(c);
+                if (digit >= 0 && size_digits_ < MAX_CHUNK_SIZE_DIGITS) {
+                    remaining_ = remaining_ * 16 + digit;
+                    size_digits_++;
+                } else if (size_digits_ > 0 && (c == ';' || c == ' ' || c == '\t')) {
+                    state_ = State::CHUNK_EXTENSION;
+                } else if (size_digits_ > 0 && c == '\r') {
+                    state_ = State::CHUNK_SIZE_LF;
+                } else {
+                    state_ = State::FAILED;
+                }
+                break;
+            }
+            case State::CHUNK_EXTENSION:
+                if (c == '\r') {
+                    state_ = State::CHUNK_SIZE_LF;
+                }
+                break;
+            case State::CHUNK_SIZE_LF:
+                if (c != '\n') {
+                    state_ = State::FAILED;
+                } else {
+                    size_digits_ = 0;
+                    state_ = remaining_ == 0 ? State::TRAILER_START : State::CHUNK_DATA;
+                }
+                break;
+            case State::CHUNK_DATA: {
+                size_t take = remaining_ < length - used ? remaining_ : length - used;
+                used += take;
+                remaining_ -= take;
+                if (remaining_ == 0) {
+                    state_ = State::CHUNK_DATA_CR;
+                }
+                continue;
+            }
+            case State::CHUNK_DATA_CR:
+                state_ = c == '\r' ? State::CHUNK_DATA_LF : State::FAILED;
+                break;
+            case State::CHUNK_DATA_LF:
+                state_ = c == '\n' ? State::CHUNK_SIZE : State::FAILED;
+                break;
+            case State::TRAILER_START:
+                state_ = c == '\r' ? State::FINAL_LF : State::TRAILER_LINE;
+                break;
+            case State::TRAILER_LINE:
+                if (c == '\r') {
+                    state_ = State::TRAILER_LF;
+                }
+                break;
+            case State::TRAILER_LF:
+                state_ = c == '\n' ? State::TRAILER_START : State::FAILED;
+                break;
+            case State::FINAL_LF:
+                state_ = c == '\n' ? State::DONE : State::FAILED;
+                break;
+            case State::DONE:
+            case State::FAILED:
+                break;
+        }
+        ++used;
+    }
+    return used;
+}
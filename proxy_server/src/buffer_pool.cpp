@@ -0,0 +1,165 @@
+#include "buffer_pool.hpp"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+std::atomic<size_t> buffers_in_use{0};
+std::atomic<size_t> bytes_in_use{0};
+std::atomic<size_t> buffers_cached{0};
+std::atomic<size_t> bytes_cached{0};
+
+struct Depot {
+    std::mutex mutex;
+    std::vector<char*> free[BufferPool::NUM_CLASSES];
+};
+
+Depot& depot() {
+    static Depot instance;
+    return instance;
+}
+
+void drop_cached(char* data, size_t class_index) {
+    buffers_cached--;
+    bytes_cached -= BufferPool::SIZE_CLASSES[class_index];
+    delete[] data;
+}
+
+void put_in_depot(char* data, size_t class_index) {
+    Depot& d = depot();
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        if (d.free[class_index].size() < BufferPool::MAX_DEPOT_CACHED) {
+            d.free[class_index].push_back(data);
+            return;
+        }
+    }
+    drop_cached(data, class_index);
+}
+
+struct ThreadCache {
+    std::vector<char*> free[BufferPool::NUM_CLASSES];
+
+    ~ThreadCache() {
+        // Hand cached buffers to the depot so the next worker can reuse them
+        for (size_t i = 0; i < BufferPool::NUM_CLASSES; ++i) {
+            for (char* data : free[i]) {
+                put_in_depot(data, i);
+            }
+        }
+    }
+};
+
+thread_local ThreadCache thread_cache;
+
+} // namespace
+
+BufferPool::Buffer::~Buffer() {
+    if (data_) {
+        BufferPool::release(data_, class_index_);
+    }
+}
+
+BufferPool::Buffer::Buffer(Buffer&& other) noexcept
+    : data_(other.data_), class_index_(other.class_index_) {
+    other.data_ = nullptr;
+}
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        if (data_) {
+            BufferPool::release(data_, class_index_);
+        }
+        data_ = other.data_;
+        class_index_ = other.class_index_;
+        other.data_ = nullptr;
+    }
+    return *this;
+}
+
+bool BufferPool::Buffer::grow(size_t used) {
+    if (!data_ || class_index_ + 1 >= NUM_CLASSES) {
+        return false;
+    }
+    resize_to(class_index_ + 1, used);
+    return true;
+}
+
+void BufferPool::Buffer::shrink(size_t used) {
+    if (!data_ || class_index_ == 0 || used > SIZE_CLASSES[0]) {
+        return;
+    }
+    resize_to(0, used);
+}
+
+void BufferPool::Buffer::resize_to(size_t class_index, size_t used) {
+    char* data = BufferPool::allocate(class_index);
+    if (used > 0) {
+        std::memcpy(data, data_, used);
+    }
+    BufferPool::release(data_, class_index_);
+    data_ = data;
+    class_index_ = class_index;
+}
+
+BufferPool::Buffer BufferPool::acquire(size_t min_size) {
+    size_t class_index = class_for(min_size);
+    return Buffer(allocate(class_index), class_index);
+}
+
+BufferPool::Stats BufferPool::stats() {
+    return Stats{buffers_in_use.load(), bytes_in_use.load(),
+                 buffers_cached.load(), bytes_cached.load()};
+}
+
+size_t BufferPool::class_for(size_t min_size) {
+    for (size_t i = 0; i < NUM_CLASSES; ++i) {
+        if (SIZE_CLASSES[i] >= min_size) {
+            return i;
+        }
+    }
+    return NUM_CLASSES - 1;
+}
+
+char* BufferPool::allocate(size_t class_index) {
+    char* data = nullptr;
+    auto& local = thread_cache.free[class_index];
+    if (!local.empty()) {
+        data = local.back();
+        local.pop_back();
+    } else {
+        Depot& d = depot();
+        std::lock_guard<std::mutex> lock(d.mutex);
+        if (!d.free[class_index].empty()) {
+            data = d.free[class_index].back();
+            d.free[class_index].pop_back();
+        }
+    }
+
+    if (data) {
+        buffers_cached--;
+        bytes_cached -= SIZE_CLASSES[class_index];
+    } else {
+        data = new char[SIZE_CLASSES[class_index]];
+    }
+
+    buffers_in_use++;
+    bytes_in_use += SIZE_CLASSES[class_index];
+    return data;
+}
+
+void BufferPool::release(char* data, size_t class_index) {
+    buffers_in_use--;
+    bytes_in_use -= SIZE_CLASSES[class_index];
+    buffers_cached++;
+    bytes_cached += SIZE_CLASSES[class_index];
+
+    auto& local = thread_cache.free[class_index];
+    if (local.size() < MAX_THREAD_CACHED) {
+        local.push_back(data);
+    } else {
+        put_in_depot(data, class_index);
+    }
+}
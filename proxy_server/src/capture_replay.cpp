@@ -0,0 +1,309 @@
+#include "capture_replay.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <strings.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+constexpr size_t IO_CHUNK = 16384;
+
+struct Result {
+    bool ok = false;
+    double latency_ms = 0;
+    uint64_t bytes = 0;
+    uint64_t body_bytes = 0;
+};
+
+int connect_to(const CaptureReplay::Endpoint& endpoint) {
+    struct addrinfo hints, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(), &hints, &result) != 0) {
+        return -1;
+    }
+    int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (sock >= 0 && connect(sock, result->ai_addr, result->ai_addrlen) < 0) {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(result);
+    return sock;
+}
+
+bool send_all(int sock, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(sock, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// Value of the field called `name` (any case), trimmed; empty if absent
+std::string header_field(const std::string& head, const char* name) {
+    size_t name_length = strlen(name);
+    size_t end = head.find("\r\n\r\n");
+    for (size_t start = head.find("\r\n"); start != std::string::npos && start < end;) {
+        start += 2;
+        size_t line_end = head.find("\r\n", start);
+        if (line_end == std::string::npos) {
+            break;
+        }
+        if (line_end - start > name_length && head[start + name_length] == ':' &&
+            strncasecmp(head.c_str() + start, name, name_length) == 0) {
+            size_t value = head.find_first_not_of(" \t", start + name_length + 1);
+            size_t value_end = head.find_last_not_of(" \t", line_end - 1);
+            return value < line_end ? head.substr(value, value_end + 1 - value) : std::string();
+        }
+        start = line_end;
+    }
+    return "";
+}
+
+uint64_t header_value(const std::string& head, const char* name) {
+    return std::strtoull(header_field(head, name).c_str(), nullptr, 10);
+}
+
+// Answers every request with as many bytes as its X-Replay-Response-Bytes asks for
+class SyntheticOrigin {
+public:
+    SyntheticOrigin() {
+        listener_ = socket(AF_INET, SOCK_STREAM, 0);
+        int opt = 1;
+        setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(listener_, (struct sockaddr*)&address, sizeof(address));
+        listen(listener_, 1024);
+        getsockname(listener_, (struct sockaddr*)&address, &length);
+        port_ = ntohs(address.sin_port);
+        thread_ = std::thread(&SyntheticOrigin::accept_loop, this);
+    }
+
+    ~SyntheticOrigin() {
+        shutdown(listener_, SHUT_RDWR);
+        thread_.join();
+        close(listener_);
+    }
+
+    int port() const { return port_; }
+
+private:
+    void accept_loop() {
+        while (true) {
+            int client = accept(listener_, nullptr, nullptr);
+            if (client < 0) {
+                return;
+            }
+            std::thread(&SyntheticOrigin::serve, client).detach();
+        }
+    }
+
+    static void serve(int client) {
+        std::string head;
+        char buffer[IO_CHUNK];
+        size_t head_end;
+        while ((head_end = head.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                close(client);
+                return;
+            }
+            head.append(buffer, received);
+        }
+
+        // Drain the request body before answering
+        uint64_t body_left = header_value(head, "Content-Length");
+        uint64_t body_read = head.size() - (head_end + 4);
+        body_left = body_left > body_read ? body_left - body_read : 0;
+        while (body_left > 0) {
+            ssize_t received = recv(client, buffer, std::min<uint64_t>(sizeof(buffer), body_left), 0);
+            if (received <= 0) {
+                break;
+            }
+            body_left -= received;
+        }
+
+        uint64_t size = header_value(head, CaptureReplay::RESPONSE_SIZE_HEADER);
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(size) +
+                               "\r\nConnection: close\r\n\r\n";
+        bool ok = send_all(client, response.data(), response.size());
+        memset(buffer, 'x', sizeof(buffer));
+        while (ok && size > 0) {
+            size_t chunk = std::min<uint64_t>(sizeof(buffer), size);
+            ok = send_all(client, buffer, chunk);
+            size -= chunk;
+        }
+        close(client);
+    }
+
+    int listener_;
+    int port_;
+    std::thread thread_;
+};
+
+// Points the captured request at the synthetic origin and asks it for the
+// captured response size
+std::string rewrite_head(const TrafficCapture::Record& record, int origin_port) {
+    const std::string& head = record.head;
+    size_t method_end = head.find(' ');
+    size_t target_end = head.find(' ', method_end + 1);
+    size_t line_end = head.find("\r\n");
+    if (method_end == std::string::npos || target_end == std::string::npos || line_end == std::string::npos) {
+        return "";
+    }
+
+    std::string target = head.substr(method_end + 1, target_end - method_end - 1);
+    size_t scheme = target.find("://");
+    size_t path_start = target.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+    std::string path = path_start == std::string::npos ? "/" : target.substr(path_start);
+    std::string origin = "127.0.0.1:" + std::to_string(origin_port);
+
+    std::string rewritten = head.substr(0, method_end) + " http://" + origin + path +
+                            head.substr(target_end, line_end - target_end) + "\r\n";
+    size_t pos = line_end + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos || end == pos) {
+            break;
+        }
+        std::string line = head.substr(pos, end - pos);
+        if (strncasecmp(line.c_str(), "Host:", 5) == 0) {
+            line = "Host: " + origin;
+        }
+        rewritten += line + "\r\n";
+        pos = end + 2;
+    }
+    rewritten += std::string(CaptureReplay::RESPONSE_SIZE_HEADER) + ": " + std::to_string(record.response_bytes) +
+                 "\r\n\r\n";
+    return rewritten;
+}
+
+Result replay_one(const CaptureReplay::Endpoint& proxy, const std::string& head, uint64_t body_bytes) {
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+    int sock = connect_to(proxy);
+    if (sock < 0) {
+        return result;
+    }
+
+    bool ok = send_all(sock, head.data(), head.size());
+    char buffer[IO_CHUNK];
+    memset(buffer, 'y', sizeof(buffer));
+    while (ok && body_bytes > 0) {
+        size_t chunk = std::min<uint64_t>(sizeof(buffer), body_bytes);
+        ok = send_all(sock, buffer, chunk);
+        body_bytes -= chunk;
+        result.body_bytes += ok ? chunk : 0;
+    }
+
+    ssize_t received;
+    while (ok && (received = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        result.bytes += received;
+    }
+    close(sock);
+
+    result.ok = ok && result.bytes > 0;
+    result.latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+} // namespace
+
+double CaptureReplay::Report::percentile(double p) const {
+    if (latencies_ms.empty()) {
+        return 0;
+    }
+    size_t index = std::min(latencies_ms.size() - 1, static_cast<size_t>(p * latencies_ms.size()));
+    return latencies_ms[index];
+}
+
+bool CaptureReplay::parse_endpoint(const std::string& text, Endpoint& endpoint) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    endpoint.host = text.substr(0, colon);
+    endpoint.port = text.substr(colon + 1);
+    return true;
+}
+
+bool CaptureReplay::is_connect(const TrafficCapture::Record& record) {
+    return record.head.compare(0, 8, "CONNECT ") == 0;
+}
+
+bool CaptureReplay::is_chunked(const TrafficCapture::Record& record) {
+    std::string coding = header_field(record.head, "Transfer-Encoding");
+    return !coding.empty() && strncasecmp(coding.c_str(), "identity", 8) != 0;
+}
+
+CaptureReplay::Report CaptureReplay::run(const std::vector<TrafficCapture::Record>& records, const Endpoint& proxy,
+                                         double speed, size_t concurrency) {
+    SyntheticOrigin origin;
+    std::vector<std::string> heads;
+    std::vector<uint64_t> bodies;
+    std::vector<uint64_t> offsets;
+    for (const auto& record : records) {
+        if (!is_replayable(record)) {
+            continue;
+        }
+        std::string head = rewrite_head(record, origin.port());
+        if (head.empty()) {
+            continue;
+        }
+        heads.push_back(head);
+        bodies.push_back(header_value(record.head, "Content-Length"));
+        offsets.push_back(record.offset_ns);
+    }
+
+    std::vector<Result> results(heads.size());
+    std::atomic<size_t> next{0};
+    uint64_t first_offset = offsets.empty() ? 0 : offsets.front();
+    auto start = std::chrono::steady_clock::now();
+
+    // Workers take requests in arrival order and wait for each one's slot
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < concurrency; ++w) {
+        workers.emplace_back([&] {
+            size_t index;
+            while ((index = next++) < heads.size()) {
+                auto due = start + std::chrono::nanoseconds(
+                    static_cast<int64_t>((offsets[index] - first_offset) / speed));
+                std::this_thread::sleep_until(due);
+                results[index] = replay_one(proxy, heads[index], bodies[index]);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    Report report;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto& result : results) {
+        report.requests++;
+        if (!result.ok) {
+            report.errors++;
+            continue;
+        }
+        report.bytes += result.bytes;
+        report.body_bytes += result.body_bytes;
+        report.latencies_ms.push_back(result.latency_ms);
+    }
+    std::sort(report.latencies_ms.begin(), report.latencies_ms.end());
+    return report;
+}
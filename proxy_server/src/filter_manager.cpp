@@ -1,22 +1,133 @@
 #include "filter_manager.hpp"
+#include "filter_snapshot.hpp"
 #include "logger.hpp"
 #include <regex>
 
-FilterManager::FilterManager() : blacklist_mode_(false) {}
+namespace {
+
+// URL rules live next to the blacklist snapshot, in the same format
+std::string rules_path(const std::string& snapshot_path) {
+    return snapshot_path + ".rules";
+}
+
+} // namespace
+
+FilterManager::FilterManager()
+    : blacklist_mode_(false), url_matcher_(std::make_shared<UrlMatcher>(std::vector<std::string>())) {}
+
+FilterManager::~FilterManager() {
+    if (persistence_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(persistence_mutex_);
+            stopping_ = true;
+        }
+        persistence_cv_.notify_all();
+        persistence_thread_.join();
+    }
+}
 
 void FilterManager::set_blacklist_mode(bool enabled) {
     blacklist_mode_ = enabled;
     Logger::get_instance().info("Blacklist mode " + std::string(enabled ? "enabled" : "disabled"));
+    mark_dirty();
 }
 
 void FilterManager::add_blacklist_entry(const std::string& entry) {
-    blacklist_.insert(entry);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        blacklist_.insert(entry);
+    }
     Logger::get_instance().info("Added blacklist entry: " + entry);
+    mark_dirty();
 }
 
 void FilterManager::remove_blacklist_entry(const std::string& entry) {
-    blacklist_.erase(entry);
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        blacklist_.erase(entry);
+    }
     Logger::get_instance().info("Removed blacklist entry: " + entry);
+    mark_dirty();
+}
+
+std::set<std::string> FilterManager::get_blacklist() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return blacklist_;
+}
+
+FilterManager::BatchResult FilterManager::apply_blacklist_batch(const std::vector<std::string>& adds,
+                                                               const std::vector<std::string>& removes) {
+    BatchResult result = {0, 0, 0};
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& entry : adds) {
+            if (!entry.empty() && blacklist_.insert(entry).second) {
+                result.added++;
+            }
+        }
+        for (const auto& entry : removes) {
+            result.removed += blacklist_.erase(entry);
+        }
+        result.total = blacklist_.size();
+    }
+    if (result.added > 0 || result.removed > 0) {
+        Logger::get_instance().info("Blacklist batch: added " + std::to_string(result.added) + ", removed " +
+                                    std::to_string(result.removed));
+        mark_dirty();
+    }
+    return result;
+}
+
+size_t FilterManager::add_blacklist_entries(const std::vector<std::string>& entries) {
+    return apply_blacklist_batch(entries, {}).added;
+}
+
+size_t FilterManager::remove_blacklist_entries(const std::vector<std::string>& entries) {
+    return apply_blacklist_batch({}, entries).removed;
+}
+
+FilterManager::BlacklistPage FilterManager::get_blacklist_page(const std::string& prefix, const std::string& after,
+                                                              size_t limit) const {
+    BlacklistPage page;
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto first = blacklist_.lower_bound(prefix);
+    auto matches = [&prefix](const std::string& entry) {
+        return entry.compare(0, prefix.size(), prefix) == 0;
+    };
+
+    // Set iterators only step one entry at a time, so matches are counted
+    // up to a cap instead of walking every one of them
+    page.total_capped = false;
+    if (prefix.empty()) {
+        page.total = blacklist_.size();
+    } else {
+        page.total = 0;
+        for (auto it = first; it != blacklist_.end() && matches(*it); ++it) {
+            if (page.total == MAX_COUNTED_MATCHES) {
+                page.total_capped = true;
+                break;
+            }
+            ++page.total;
+        }
+    }
+
+    // The bounds are O(log n) and the walks are capped, so a page costs the
+    // same anywhere in a list of any size
+    auto it = first;
+    if (!after.empty() && after >= prefix) {
+        it = blacklist_.upper_bound(after);
+    }
+
+    for (; it != blacklist_.end() && page.entries.size() < limit && matches(*it); ++it) {
+        page.entries.push_back(*it);
+    }
+    page.has_more = it != blacklist_.end() && matches(*it);
+    return page;
+}
+
+size_t FilterManager::blacklist_size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return blacklist_.size();
 }
 
 bool FilterManager::is_blocked(const std::string& url) const {
@@ -47,6 +158,7 @@ bool FilterManager::is_blocked(const std::string& url) const {
     
     Logger::get_instance().debug("Checking domain: " + domain);
     
+    std::shared_lock<std::shared_mutex> lock(mutex_);
     for (const auto& entry : blacklist_) {
         if (domain == entry) {
             Logger::get_instance().info("Domain blocked: " + domain + " (matches blacklist entry: " + entry + ")");
@@ -55,4 +167,203 @@ bool FilterManager::is_blocked(const std::string& url) const {
     }
     
     return false;
-} 
\ No newline at end of file
+}
+
+FilterManager::BatchResult FilterManager::apply_url_rule_batch(const std::vector<std::string>& adds,
+                                                              const std::vector<std::string>& removes) {
+    BatchResult result = {0, 0, 0};
+    {
+        std::lock_guard<std::mutex> lock(rules_mutex_);
+        for (const auto& rule : adds) {
+            if (!rule.empty() && rule != "|" && rule != "||" && url_rules_.insert(rule).second) {
+                result.added++;
+            }
+        }
+        for (const auto& rule : removes) {
+            result.removed += url_rules_.erase(rule);
+        }
+        result.total = url_rules_.size();
+        if (result.added > 0 || result.removed > 0) {
+            rebuild_url_matcher();
+        }
+    }
+    if (result.added > 0 || result.removed > 0) {
+        Logger::get_instance().info("URL rule batch: added " + std::to_string(result.added) + ", removed " +
+                                    std::to_string(result.removed));
+        mark_dirty();
+    }
+    return result;
+}
+
+bool FilterManager::add_url_rule(const std::string& rule) {
+    return apply_url_rule_batch({rule}, {}).added > 0;
+}
+
+bool FilterManager::remove_url_rule(const std::string& rule) {
+    return apply_url_rule_batch({}, {rule}).removed > 0;
+}
+
+std::vector<std::string> FilterManager::get_url_rules() const {
+    std::lock_guard<std::mutex> lock(rules_mutex_);
+    return std::vector<std::string>(url_rules_.begin(), url_rules_.end());
+}
+
+std::string FilterManager::match_url_rule(std::string_view url) const {
+    std::string rule;
+    match_url_rule({url}, rule);
+    return rule;
+}
+
+bool FilterManager::match_url_rule(std::initializer_list<std::string_view> pieces, std::string& rule) const {
+    if (!blacklist_mode_) {
+        return false;
+    }
+    std::shared_ptr<const UrlMatcher> matcher = std::atomic_load(&url_matcher_);
+    int index = matcher->find_concatenated(pieces);
+    if (index < 0) {
+        return false;
+    }
+    rule = matcher->rule(index);
+    return true;
+}
+
+void FilterManager::rebuild_url_matcher() {
+    auto matcher = std::make_shared<const UrlMatcher>(std::vector<std::string>(url_rules_.begin(), url_rules_.end()));
+    Logger::get_instance().debug("Compiled " + std::to_string(matcher->rule_count()) + " URL rules into " +
+                                 std::to_string(matcher->state_count()) + " states, " +
+                                 std::to_string(matcher->class_count()) + " byte classes");
+    std::atomic_store(&url_matcher_, std::shared_ptr<const UrlMatcher>(std::move(matcher)));
+}
+
+bool FilterManager::enable_persistence(const std::string& path) {
+    if (persistence_thread_.joinable()) {
+        return false;
+    }
+    snapshot_path_ = path;
+
+    auto load_start = std::chrono::steady_clock::now();
+    if (reload_snapshot()) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - load_start);
+        Logger::get_instance().info("Loaded filter snapshot " + path + " in " +
+                                    std::to_string(elapsed.count()) + " ms");
+    }
+
+    persistence_thread_ = std::thread(&FilterManager::persistence_loop, this);
+    return true;
+}
+
+bool FilterManager::save_snapshot() {
+    if (snapshot_path_.empty()) {
+        return false;
+    }
+    std::set<std::string> entries = get_blacklist();
+    std::set<std::string> rules;
+    {
+        std::lock_guard<std::mutex> lock(rules_mutex_);
+        rules = url_rules_;
+    }
+    return FilterSnapshot::write(snapshot_path_, entries, blacklist_mode_) &&
+           FilterSnapshot::write(rules_path(snapshot_path_), rules, false);
+}
+
+bool FilterManager::reload_snapshot() {
+    if (snapshot_path_.empty()) {
+        return false;
+    }
+
+    std::set<std::string> entries;
+    bool mode = false;
+    if (!FilterSnapshot::read(snapshot_path_, entries, mode)) {
+        return false;
+    }
+
+    size_t count = entries.size();
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        blacklist_.swap(entries);
+    }
+    blacklist_mode_ = mode;
+
+    // Older snapshots have no rules file; keep the current rules then
+    std::set<std::string> rules;
+    bool unused_mode = false;
+    if (FilterSnapshot::read(rules_path(snapshot_path_), rules, unused_mode)) {
+        std::lock_guard<std::mutex> lock(rules_mutex_);
+        url_rules_.swap(rules);
+        rebuild_url_matcher();
+    }
+    Logger::get_instance().info("Filter snapshot loaded: " + std::to_string(count) + " entries, " +
+                                std::to_string(get_url_rules().size()) + " URL rules");
+    return true;
+}
+
+bool FilterManager::request_reload() {
+    if (!persistence_thread_.joinable()) {
+        Logger::get_instance().warning("Reload requested but no filter snapshot is configured");
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(persistence_mutex_);
+        reload_requested_ = true;
+    }
+    persistence_cv_.notify_all();
+    return true;
+}
+
+bool FilterManager::wait_for_persistence(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(persistence_mutex_);
+    return persistence_cv_.wait_for(lock, timeout, [this] { return !dirty_ && !reload_requested_ && !persisting_; });
+}
+
+void FilterManager::mark_dirty() {
+    if (!persistence_thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(persistence_mutex_);
+        dirty_ = true;
+    }
+    persistence_cv_.notify_all();
+}
+
+void FilterManager::persistence_loop() {
+    std::unique_lock<std::mutex> lock(persistence_mutex_);
+    while (true) {
+        persistence_cv_.wait(lock, [this] { return stopping_ || dirty_ || reload_requested_; });
+
+        if (reload_requested_) {
+            reload_requested_ = false;
+            dirty_ = false;
+            persisting_ = true;
+            lock.unlock();
+            reload_snapshot();
+            lock.lock();
+            persisting_ = false;
+            persistence_cv_.notify_all();
+            continue;
+        }
+
+        if (dirty_) {
+            // Let a burst of changes settle into one write
+            if (!stopping_) {
+                persistence_cv_.wait_for(lock, SNAPSHOT_DEBOUNCE, [this] { return stopping_ || reload_requested_; });
+                if (reload_requested_) {
+                    continue;
+                }
+            }
+            dirty_ = false;
+            persisting_ = true;
+            lock.unlock();
+            save_snapshot();
+            lock.lock();
+            persisting_ = false;
+            persistence_cv_.notify_all();
+            continue;
+        }
+
+        if (stopping_) {
+            break;
+        }
+    }
+}
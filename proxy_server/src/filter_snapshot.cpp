@@ -0,0 +1,124 @@
+#include "filter_snapshot.hpp"
+#include "logger.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+bool write_all(int fd, const void* data, size_t length) {
+    const char* ptr = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t written = ::write(fd, ptr, length);
+        if (written <= 0) {
+            return false;
+        }
+        ptr += written;
+        length -= written;
+    }
+    return true;
+}
+
+} // namespace
+
+bool FilterSnapshot::write(const std::string& path, const std::set<std::string>& entries, bool blacklist_mode) {
+    std::vector<uint32_t> offsets;
+    offsets.reserve(entries.size() + 1);
+    uint64_t blob_size = 0;
+    for (const auto& entry : entries) {
+        offsets.push_back(static_cast<uint32_t>(blob_size));
+        blob_size += entry.size();
+    }
+    offsets.push_back(static_cast<uint32_t>(blob_size));
+
+    if (blob_size > UINT32_MAX) {
+        Logger::get_instance().error("Filter snapshot too large: " + path);
+        return false;
+    }
+
+    Header header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.flags = blacklist_mode ? FLAG_BLACKLIST_MODE : 0;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.blob_size = blob_size;
+
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        Logger::get_instance().error("Failed to open filter snapshot for writing: " + tmp_path);
+        return false;
+    }
+
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, offsets.data(), offsets.size() * sizeof(uint32_t));
+    for (auto it = entries.begin(); ok && it != entries.end(); ++it) {
+        ok = write_all(fd, it->data(), it->size());
+    }
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        Logger::get_instance().error("Failed to write filter snapshot: " + path);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool FilterSnapshot::read(const std::string& path, std::set<std::string>& entries, bool& blacklist_mode) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        close(fd);
+        Logger::get_instance().error("Filter snapshot truncated: " + path);
+        return false;
+    }
+
+    size_t file_size = st.st_size;
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        Logger::get_instance().error("Failed to map filter snapshot: " + path);
+        return false;
+    }
+
+    const char* base = static_cast<const char*>(mapping);
+    const Header* header = reinterpret_cast<const Header*>(base);
+    size_t offsets_size = (static_cast<size_t>(header->entry_count) + 1) * sizeof(uint32_t);
+    // Bound each part by the file size first so the sum cannot wrap
+    bool valid = header->magic == MAGIC && header->version == VERSION &&
+                 header->blob_size <= file_size && offsets_size <= file_size &&
+                 sizeof(Header) + offsets_size + header->blob_size == file_size;
+
+    if (valid) {
+        const uint32_t* offsets = reinterpret_cast<const uint32_t*>(base + sizeof(Header));
+        const char* blob = base + sizeof(Header) + offsets_size;
+        std::set<std::string> loaded;
+        for (uint32_t i = 0; valid && i < header->entry_count; ++i) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > header->blob_size) {
+                valid = false;
+                break;
+            }
+            // Entries are stored sorted, so each insert is amortized O(1)
+            loaded.emplace_hint(loaded.end(), blob + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+        if (valid) {
+            entries.swap(loaded);
+            blacklist_mode = (header->flags & FLAG_BLACKLIST_MODE) != 0;
+        }
+    }
+
+    munmap(mapping, file_size);
+    if (!valid) {
+        Logger::get_instance().error("Invalid filter snapshot: " + path);
+    }
+    return valid;
+}
@@ -0,0 +1,250 @@
+#include "header_rewriter.hpp"
+#include <sys/socket.h>
+#include <strings.h>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+
+namespace {
+
+struct HeaderLine {
+    size_t start;
+    size_t end;  // excludes CRLF
+    std::string_view name;
+    std::string_view value;
+    bool continuation;
+};
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool is_hop_by_hop(std::string_view name, bool to_parent) {
+    static constexpr std::string_view HOP_BY_HOP[] = {
+        "Connection", "Proxy-Connection", "Keep-Alive", "TE", "Trailer", "Upgrade"};
+    for (std::string_view header : HOP_BY_HOP) {
+        if (iequals(name, header)) {
+            return true;
+        }
+    }
+    // Credentials for a parent proxy must never reach an origin
+    return !to_parent && iequals(name, "Proxy-Authorization");
+}
+
+// The body is framed, and the request filtered, from these fields of the
+// original head; dropping one would let the origin see a different request
+bool is_end_to_end_framing(std::string_view name) {
+    return iequals(name, "Content-Length") || iequals(name, "Transfer-Encoding") || iequals(name, "Host");
+}
+
+} // namespace
+
+bool HeaderRewriter::rewrite(std::string_view request, const Options& options) {
+    request_ = request;
+    inserted_.clear();
+    layout_.clear();
+    slices_.clear();
+
+    size_t head_end = request.find("\r\n\r\n");
+    if (head_end == std::string_view::npos) {
+        return false;
+    }
+
+    size_t line_end = request.find("\r\n");
+    std::string_view request_line = request.substr(0, line_end);
+    size_t method_end = request_line.find(' ');
+    size_t target_end = request_line.rfind(' ');
+    if (method_end == std::string_view::npos || target_end <= method_end + 1) {
+        return false;
+    }
+    std::string_view target = request_line.substr(method_end + 1, target_end - method_end - 1);
+    std::string_view version = request_line.substr(target_end + 1);
+    if (version.substr(0, 5) != "HTTP/") {
+        return false;
+    }
+
+    std::vector<HeaderLine> lines;
+    std::vector<std::string_view> connection_tokens;
+    for (size_t start = line_end + 2; start < head_end + 2;) {
+        size_t end = request.find("\r\n", start);
+        std::string_view text = request.substr(start, end - start);
+        HeaderLine line{start, end, {}, {}, text.front() == ' ' || text.front() == '\t'};
+        if (!line.continuation) {
+            size_t colon = text.find(':');
+            if (colon == std::string_view::npos || colon == 0) {
+                return false;
+            }
+            line.name = text.substr(0, colon);
+            line.value = trim(text.substr(colon + 1));
+            if (iequals(line.name, "Connection")) {
+                // Headers named in Connection are hop-by-hop as well
+                std::string_view tokens = line.value;
+                while (!tokens.empty()) {
+                    size_t comma = tokens.find(',');
+                    std::string_view token = trim(tokens.substr(0, comma));
+                    if (is_end_to_end_framing(token)) {
+                        return false;
+                    }
+                    connection_tokens.push_back(token);
+                    tokens = comma == std::string_view::npos ? std::string_view() : tokens.substr(comma + 1);
+                }
+            }
+        }
+        lines.push_back(line);
+        start = end + 2;
+    }
+
+    // Request line, with the scheme and authority cut from an absolute-form target
+    add_original(0, method_end + 1);
+    if (!options.keep_absolute_form && target.size() > 7 && iequals(target.substr(0, 7), "http://")) {
+        size_t path = target.find('/', 7);
+        if (path == std::string_view::npos) {
+            add_inserted("/");
+        } else {
+            add_original(method_end + 1 + path, target.size() - path);
+        }
+    } else {
+        add_original(method_end + 1, target.size());
+    }
+    add_original(target_end, line_end + 2 - target_end);
+
+    std::string_view protocol = version.substr(5);
+    bool has_via = false;
+    bool has_forwarded_for = false;
+    bool skipping = false;
+    for (const HeaderLine& line : lines) {
+        if (line.continuation) {
+            if (!skipping) {
+                add_original(line.start, line.end + 2 - line.start);
+            }
+            continue;
+        }
+
+        auto named = [&line](std::string_view name) { return iequals(line.name, name); };
+        skipping = is_hop_by_hop(line.name, options.keep_absolute_form) ||
+                   std::any_of(connection_tokens.begin(), connection_tokens.end(), named) ||
+                   (options.removed_fields && !is_end_to_end_framing(line.name) &&
+                    std::any_of(options.removed_fields->begin(), options.removed_fields->end(), named));
+        if (skipping) {
+            continue;
+        }
+
+        // Existing Via and X-Forwarded-For lists are extended in place
+        if (iequals(line.name, "Via")) {
+            has_via = true;
+            add_original(line.start, line.end - line.start);
+            add_inserted(", ");
+            add_inserted(protocol);
+            add_inserted(" ");
+            add_inserted(VIA_PSEUDONYM);
+            add_inserted("\r\n");
+        } else if (iequals(line.name, "X-Forwarded-For") && !options.client_address.empty()) {
+            has_forwarded_for = true;
+            add_original(line.start, line.end - line.start);
+            add_inserted(", ");
+            add_inserted(options.client_address);
+            add_inserted("\r\n");
+        } else {
+            add_original(line.start, line.end + 2 - line.start);
+        }
+    }
+
+    add_inserted(options.added_fields);
+    // Responses are relayed until the upstream closes
+    add_inserted("Connection: close\r\n");
+    if (!has_via) {
+        add_inserted("Via: ");
+        add_inserted(protocol);
+        add_inserted(" ");
+        add_inserted(VIA_PSEUDONYM);
+        add_inserted("\r\n");
+    }
+    if (!has_forwarded_for && !options.client_address.empty()) {
+        add_inserted("X-Forwarded-For: ");
+        add_inserted(options.client_address);
+        add_inserted("\r\n");
+    }
+
+    // Blank line and any body bytes that arrived with the head
+    add_original(head_end + 2, request.size() - head_end - 2);
+
+    // Inserted text is final now, so slices can point into it
+    slices_.reserve(layout_.size());
+    for (const Slice& slice : layout_) {
+        const char* base = slice.inserted ? inserted_.data() : request_.data();
+        slices_.push_back({const_cast<char*>(base + slice.offset), slice.length});
+    }
+    return true;
+}
+
+void HeaderRewriter::add_original(size_t offset, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    if (!layout_.empty() && !layout_.back().inserted &&
+        layout_.back().offset + layout_.back().length == offset) {
+        layout_.back().length += length;
+        return;
+    }
+    layout_.push_back({false, offset, length});
+}
+
+void HeaderRewriter::add_inserted(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+    if (!layout_.empty() && layout_.back().inserted) {
+        layout_.back().length += text.size();
+    } else {
+        layout_.push_back({true, inserted_.size(), text.size()});
+    }
+    inserted_.append(text);
+}
+
+size_t HeaderRewriter::size() const {
+    size_t total = 0;
+    for (const struct iovec& slice : slices_) {
+        total += slice.iov_len;
+    }
+    return total;
+}
+
+bool HeaderRewriter::send(int socket) const {
+    std::vector<struct iovec> pending(slices_);
+    size_t index = 0;
+    while (index < pending.size()) {
+        struct msghdr message = {};
+        message.msg_iov = &pending[index];
+        message.msg_iovlen = std::min<size_t>(pending.size() - index, IOV_MAX);
+
+        ssize_t sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        // Skip what was written and resume mid-slice after a short write
+        size_t remaining = sent;
+        while (index < pending.size() && remaining >= pending[index].iov_len) {
+            remaining -= pending[index].iov_len;
+            ++index;
+        }
+        if (remaining > 0) {
+            pending[index].iov_base = static_cast<char*>(pending[index].iov_base) + remaining;
+            pending[index].iov_len -= remaining;
+        }
+    }
+    return true;
+}
@@ -1,21 +1,204 @@
 #include "proxy_server.hpp"
 #include "filter_manager.hpp"
 #include "web_ui.hpp"
+#include "rate_limiter.hpp"
+#include "upstream_pool.hpp"
+#include "socket_handoff.hpp"
+#include "traffic_capture.hpp"
+#include "socket_profile.hpp"
+#include "access_list.hpp"
 #include <iostream>
 #include <thread>
+#include <string>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <csignal>
+#include <pthread.h>
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <proxy_port> <web_ui_port>" << std::endl;
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <proxy_port> <web_ui_port> [--snapshot=<path>]"
+                  << " [--rps=<n>] [--rps-burst=<n>] [--max-client-connections=<n>]"
+                  << " [--bps=<n>] [--bps-burst=<n>]"
+                  << " [--upstream=<host:port[/weight]>]... [--upstream-policy=weighted|least-conn|hash]"
+                  << " [--upstream-probe-ms=<n>]"
+                  << " [--upgrade-socket=<path>] [--drain-timeout-ms=<n>] [--head-timeout-ms=<n>]"
+                  << " [--capture=<path>] [--capture-sample=<0..1>]"
+                  << " [--socket-profile=default|latency|bulk[,key=value...]]"
+                  << " [--allow=<cidr>]... [--deny=<cidr>]... [--access-list=<path>]" << std::endl;
         return 1;
     }
 
     int proxy_port = std::stoi(argv[1]);
     int web_ui_port = std::stoi(argv[2]);
 
+    std::string snapshot_path;
+    RateLimiter::Config rate_limits;
+    bool rate_limited = false;
+    std::vector<std::string> upstreams;
+    UpstreamPool::Policy upstream_policy = UpstreamPool::Policy::WEIGHTED;
+    int upstream_probe_ms = 5000;
+    std::string upgrade_socket_path;
+    int drain_timeout_ms = 30000;
+    int head_timeout_ms = ProxyServer::HEAD_TIMEOUT_MS;
+    std::string capture_path;
+    double capture_sample = 1.0;
+    SocketProfile socket_profile;
+    AccessList access_list;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--snapshot=", 0) == 0) {
+            snapshot_path = arg.substr(11);
+        } else if (arg.rfind("--rps=", 0) == 0) {
+            rate_limits.requests_per_second = std::stod(arg.substr(6));
+            rate_limited = true;
+        } else if (arg.rfind("--rps-burst=", 0) == 0) {
+            rate_limits.request_burst = std::stod(arg.substr(12));
+            if (rate_limits.request_burst < 1) {
+                // Every request costs one token, so a smaller bucket refuses them all
+                std::cerr << "--rps-burst must be at least 1" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--max-client-connections=", 0) == 0) {
+            rate_limits.max_connections = std::stoi(arg.substr(25));
+            rate_limited = true;
+        } else if (arg.rfind("--bps=", 0) == 0) {
+            rate_limits.bytes_per_second = std::stod(arg.substr(6));
+            rate_limited = true;
+        } else if (arg.rfind("--bps-burst=", 0) == 0) {
+            rate_limits.byte_burst = std::stod(arg.substr(12));
+        } else if (arg.rfind("--upstream=", 0) == 0) {
+            upstreams.push_back(arg.substr(11));
+        } else if (arg.rfind("--upstream-policy=", 0) == 0) {
+            if (!UpstreamPool::parse_policy(arg.substr(18), upstream_policy)) {
+                std::cerr << "Unknown upstream policy: " << arg.substr(18) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--upstream-probe-ms=", 0) == 0) {
+            upstream_probe_ms = std::stoi(arg.substr(20));
+        } else if (arg.rfind("--upgrade-socket=", 0) == 0) {
+            upgrade_socket_path = arg.substr(17);
+        } else if (arg.rfind("--drain-timeout-ms=", 0) == 0) {
+            drain_timeout_ms = std::stoi(arg.substr(19));
+        } else if (arg.rfind("--head-timeout-ms=", 0) == 0) {
+            head_timeout_ms = std::stoi(arg.substr(18));
+            if (head_timeout_ms < 1) {
+                std::cerr << "--head-timeout-ms must be at least 1" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--capture=", 0) == 0) {
+            capture_path = arg.substr(10);
+        } else if (arg.rfind("--capture-sample=", 0) == 0) {
+            capture_sample = std::stod(arg.substr(17));
+        } else if (arg.rfind("--socket-profile=", 0) == 0) {
+            if (!SocketProfile::parse(arg.substr(17), socket_profile)) {
+                std::cerr << "Invalid socket profile: " << arg.substr(17) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--allow=", 0) == 0) {
+            if (!access_list.add(arg.substr(8), AccessList::Action::ALLOW)) {
+                return 1;
+            }
+        } else if (arg.rfind("--deny=", 0) == 0) {
+            if (!access_list.add(arg.substr(7), AccessList::Action::DENY)) {
+                return 1;
+            }
+        } else if (arg.rfind("--access-list=", 0) == 0) {
+            if (!access_list.load_file(arg.substr(14))) {
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // SIGHUP reloads the filter snapshot; block it here so only the
+    // signal thread below receives it
+    sigset_t reload_signals;
+    sigemptyset(&reload_signals);
+    sigaddset(&reload_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &reload_signals, nullptr);
+
+    // Declared before the server so they outlive its worker threads
+    std::unique_ptr<RateLimiter> rate_limiter;
+    std::unique_ptr<UpstreamPool> upstream_pool;
+    std::unique_ptr<TrafficCapture> capture;
+
     FilterManager filter_manager;
     ProxyServer server(proxy_port, filter_manager);
     WebUI web_ui(web_ui_port, filter_manager);
+    web_ui.set_proxy_server(&server);
+    server.set_socket_profile(socket_profile);
+    server.set_head_timeout(std::chrono::milliseconds(head_timeout_ms));
+    if (!access_list.empty()) {
+        access_list.compact();
+        server.set_access_list(&access_list);
+    }
+
+    if (rate_limited) {
+        rate_limiter = std::make_unique<RateLimiter>(rate_limits);
+        server.set_rate_limiter(rate_limiter.get());
+        web_ui.set_rate_limiter(rate_limiter.get());
+    }
+
+    if (!upstreams.empty()) {
+        upstream_pool = std::make_unique<UpstreamPool>(upstream_policy);
+        for (const auto& spec : upstreams) {
+            // host:port[/weight]
+            size_t weight_pos = spec.find('/');
+            std::string address = spec.substr(0, weight_pos);
+            size_t colon_pos = address.rfind(':');
+            if (colon_pos == std::string::npos) {
+                std::cerr << "Invalid upstream: " << spec << std::endl;
+                return 1;
+            }
+            int weight = weight_pos == std::string::npos ? 1 : std::stoi(spec.substr(weight_pos + 1));
+            upstream_pool->add_upstream(address.substr(0, colon_pos), std::stoi(address.substr(colon_pos + 1)), weight);
+        }
+        upstream_pool->start_health_checks(std::chrono::milliseconds(upstream_probe_ms));
+        server.set_upstream_pool(upstream_pool.get());
+    }
+
+    if (!capture_path.empty()) {
+        capture = std::make_unique<TrafficCapture>(capture_path, capture_sample);
+        if (!capture->is_open()) {
+            return 1;
+        }
+        server.set_traffic_capture(capture.get());
+    }
+
+    if (!snapshot_path.empty()) {
+        filter_manager.enable_persistence(snapshot_path);
+    }
+
+    std::thread signal_thread([&filter_manager, reload_signals]() {
+        int signal = 0;
+        while (sigwait(&reload_signals, &signal) == 0) {
+            filter_manager.request_reload();
+        }
+    });
+    signal_thread.detach();
+
+    // Graceful upgrade: inherit the listening socket from a running proxy if
+    // one serves the upgrade socket, then offer ours to the next binary
+    std::unique_ptr<SocketHandoff> handoff;
+    if (!upgrade_socket_path.empty()) {
+        handoff = std::make_unique<SocketHandoff>(upgrade_socket_path);
+        int listener = handoff->take_over();
+        if (listener >= 0) {
+            server.adopt_listener(listener);
+        } else if (!server.open_listener()) {
+            std::cerr << "Failed to open listening socket" << std::endl;
+            return 1;
+        }
+        handoff->acknowledge();
+        handoff->serve(server.listener(), [&server, &web_ui]() {
+            web_ui.stop();
+            server.stop_accepting();
+        });
+    }
 
     std::thread web_thread([&web_ui]() {
         web_ui.start();
@@ -23,6 +206,11 @@ int main(int argc, char* argv[]) {
 
     server.start();
 
+    if (handoff) {
+        // start() returns once the successor took over the listening socket
+        server.drain(std::chrono::milliseconds(drain_timeout_ms));
+    }
+
     web_thread.join();
     return 0;
-} 
\ No newline at end of file
+}
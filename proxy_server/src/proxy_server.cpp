@@ -1,18 +1,71 @@
 #include "proxy_server.hpp"
 #include "logger.hpp"
+#include "buffer_pool.hpp"
+#include "header_rewriter.hpp"
+#include "body_framer.hpp"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <cstring>
+#include <cstdio>
 #include <iostream>
 #include <algorithm>
 #include <sstream>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <regex>
+#include <sys/select.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <strings.h>
+#include <charconv>
+
+namespace {
+
+std::string format_address(const struct sockaddr_storage& addr) {
+    char text[INET6_ADDRSTRLEN] = "";
+    if (addr.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &((const struct sockaddr_in*)&addr)->sin_addr, text, sizeof(text));
+    } else if (addr.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &((const struct sockaddr_in6*)&addr)->sin6_addr, text, sizeof(text));
+    }
+    return text;
+}
+
+// Accepts only plain decimal digits naming a port in 1-65535
+bool parse_port(std::string_view text, uint16_t& port) {
+    unsigned value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size() || value == 0 || value > 65535) {
+        return false;
+    }
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+// Authority of an absolute-form target ("http://host[:port]/path"), or empty
+std::string_view target_authority(std::string_view target) {
+    if (target.size() < 7 || strncasecmp(target.data(), "http://", 7) != 0) {
+        return {};
+    }
+    target.remove_prefix(7);
+    return target.substr(0, target.find_first_of("/?#"));
+}
+
+// Splits "host[:port]", defaulting to port 80
+bool split_authority(std::string_view authority, std::string& host, uint16_t& port) {
+    size_t colon = authority.find(':');
+    host = std::string(authority.substr(0, colon));
+    port = 80;
+    return !host.empty() && (colon == std::string_view::npos || parse_port(authority.substr(colon + 1), port));
+}
+
+} // namespace
 
 ProxyServer::ProxyServer(uint16_t port, FilterManager& filter_manager)
-    : port_(port), server_socket_(-1), running_(false), filter_manager_(filter_manager) {
+    : port_(port), server_socket_(-1), running_(false), filter_manager_(filter_manager),
+      request_filters_(HostBlacklistStage(filter_manager), UrlRuleStage(filter_manager)) {
     Logger::get_instance().info("Proxy server initialized on port " + std::to_string(port));
     filter_manager_.set_blacklist_mode(true);  //  toggle blacklist mode
 }
@@ -44,25 +97,65 @@ bool ProxyServer::initialize_socket() {
         return false;
     }
 
+    socket_profile_.apply_listener(server_socket_);
     if (listen(server_socket_, MAX_CONNECTIONS) < 0) {
         Logger::get_instance().error("Failed to listen on socket");
         return false;
     }
 
-    Logger::get_instance().info("Socket initialized successfully");
+    Logger::get_instance().info("Socket initialized successfully, profile " + socket_profile_.describe());
     return true;
 }
 
 void ProxyServer::start() {
-    if (!initialize_socket()) {
+    if (!open_listener()) {
         throw std::runtime_error("Failed to initialize socket");
     }
 
     running_ = true;
+    accepting_ = true;
     Logger::get_instance().info("Proxy server started");
     accept_connections();
 }
 
+bool ProxyServer::open_listener() {
+    return server_socket_ >= 0 || initialize_socket();
+}
+
+void ProxyServer::adopt_listener(int listener) {
+    server_socket_ = listener;
+    Logger::get_instance().info("Using inherited listening socket");
+}
+
+void ProxyServer::stop_accepting() {
+    accepting_ = false;
+}
+
+void ProxyServer::drain(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Logger::get_instance().info("Draining " + std::to_string(active_connections_.size()) + " connections");
+
+    if (!drained_cv_.wait_for(lock, timeout, [this] { return active_connections_.empty(); })) {
+        // Deadline passed: cut the stragglers so their workers return
+        Logger::get_instance().warning("Drain deadline reached, closing " +
+                                       std::to_string(active_connections_.size()) + " connections");
+        for (const auto& [id, socket] : active_connections_) {
+            shutdown(socket, SHUT_RDWR);
+        }
+    }
+    lock.unlock();
+
+    for (auto& thread : worker_threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    worker_threads_.clear();
+    running_ = false;
+    log_filter_stats();
+    Logger::get_instance().info("Proxy server drained");
+}
+
 void ProxyServer::stop() {
     running_ = false;
     if (server_socket_ >= 0) {
@@ -76,22 +169,71 @@ void ProxyServer::stop() {
         }
     }
     worker_threads_.clear();
+    log_filter_stats();
     Logger::get_instance().info("Proxy server stopped");
 }
 
+void ProxyServer::log_filter_stats() const {
+    for (const FilterStageStats& stage : filter_stats()) {
+        uint64_t average_ns = stage.calls ? stage.nanoseconds / stage.calls : 0;
+        Logger::get_instance().info("Filter stage " + std::string(stage.name) + ": " + std::to_string(stage.calls) +
+                                    " calls, " + std::to_string(stage.denials) + " denied, " +
+                                    std::to_string(stage.modifications) + " modified, " +
+                                    std::to_string(average_ns) + " ns average");
+    }
+}
+
 bool ProxyServer::is_running() const {
     return running_;
 }
 
 void ProxyServer::accept_connections() {
-    while (running_) {
-        int client_socket = accept(server_socket_, nullptr, nullptr);
+    int backoff_ms = 0;
+    while (running_ && accepting_) {
+        // Poll so a handoff can stop the loop without closing the shared socket
+        struct pollfd listener = {server_socket_, POLLIN, 0};
+        if (poll(&listener, 1, ACCEPT_POLL_MS) <= 0) {
+            continue;
+        }
+
+        struct sockaddr_storage client_addr;
+        socklen_t client_addr_len = sizeof(client_addr);
+        int client_socket = accept(server_socket_, (struct sockaddr*)&client_addr, &client_addr_len);
         if (client_socket < 0) {
-            if (running_) {
-                Logger::get_instance().error("Failed to accept connection");
+            if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED || !running_) {
+                continue;
             }
+            // Out of descriptors or memory: the listener stays readable, so
+            // retrying at once would spin until a connection closes
+            backoff_ms = std::min(backoff_ms > 0 ? backoff_ms * 2 : ACCEPT_BACKOFF_MIN_MS, ACCEPT_POLL_MS);
+            Logger::get_instance().error(std::string("Failed to accept connection: ") + strerror(errno) +
+                                         ", retrying in " + std::to_string(backoff_ms) + " ms");
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms));
             continue;
         }
+        backoff_ms = 0;
+
+        if (access_list_ && !access_list_->allows(client_addr)) {
+            Logger::get_instance().debug("Rejected client " + format_address(client_addr) + " by access list");
+            close(client_socket);
+            continue;
+        }
+
+        socket_profile_.apply_client(client_socket);
+
+        Connection connection;
+        connection.id = next_connection_id_++;
+        connection.socket = client_socket;
+        connection.client_address = format_address(client_addr);
+        if (rate_limiter_) {
+            connection.lease = rate_limiter_->open_connection(connection.client_address);
+            if (!connection.lease) {
+                Logger::get_instance().warning("Rate limit exceeded for client " + connection.client_address);
+                send_error_response(client_socket, "429 Too Many Requests");
+                close(client_socket);
+                continue;
+            }
+        }
 
         worker_threads_.erase(
             std::remove_if(worker_threads_.begin(), worker_threads_.end(),
@@ -99,27 +241,123 @@ void ProxyServer::accept_connections() {
             worker_threads_.end()
         );
 
-        worker_threads_.emplace_back(&ProxyServer::handle_connection, this, client_socket);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_connections_.emplace(connection.id, client_socket);
+        }
+        worker_threads_.emplace_back(&ProxyServer::run_connection, this, std::move(connection));
+    }
+
+    if (!accepting_ && server_socket_ >= 0) {
+        // The successor holds its own reference to the listening socket
+        close(server_socket_);
+        server_socket_ = -1;
     }
 }
 
-void ProxyServer::handle_connection(int client_socket) {
-    char buffer[BUFFER_SIZE];
-    int bytes_read = read(client_socket, buffer, sizeof(buffer) - 1);
-    
-    if (bytes_read <= 0) {
-        Logger::get_instance().error("Failed to read from client socket");
-        close(client_socket);
+void ProxyServer::run_connection(Connection connection) {
+    uint64_t id = connection.id;
+    auto started = std::chrono::steady_clock::now();
+    if (capture_ && capture_->should_sample()) {
+        connection.sampled = true;
+        connection.capture.offset_ns = capture_->offset_now();
+    }
+
+    handle_connection(connection);
+
+    if (connection.sampled) {
+        connection.capture.duration_us = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+        capture_->record(connection.capture);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_connections_.erase(id);
+    // Closed only once unregistered, so drain() never shuts down a reused descriptor
+    close(connection.socket);
+    drained_cv_.notify_all();
+}
+
+long ProxyServer::read_request_head(int socket, BufferPool::Buffer& buffer, size_t& received) {
+    received = 0;
+    // One deadline for the whole head, so a client trickling bytes cannot
+    // hold a worker thread by keeping each read short
+    auto deadline = std::chrono::steady_clock::now() + head_timeout_;
+    while (true) {
+        if (received == buffer.capacity() && (buffer.capacity() >= MAX_HEAD_SIZE || !buffer.grow(received))) {
+            return HEAD_TOO_LARGE;
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        struct pollfd pending = {socket, POLLIN, 0};
+        int ready = remaining.count() > 0 ? poll(&pending, 1, static_cast<int>(remaining.count())) : 0;
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready == 0) {
+            return HEAD_TIMED_OUT;
+        }
+        if (ready < 0) {
+            return 0;
+        }
+
+        ssize_t bytes = recv(socket, buffer.data() + received, buffer.capacity() - received, 0);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return 0;
+        }
+
+        // The terminator may straddle two reads
+        size_t search_from = received > 3 ? received - 3 : 0;
+        received += bytes;
+        size_t head_end = std::string_view(buffer.data(), received).find("\r\n\r\n", search_from);
+        if (head_end != std::string_view::npos) {
+            return static_cast<long>(head_end + 4);
+        }
+    }
+}
+
+void ProxyServer::handle_connection(Connection& connection) {
+    int client_socket = connection.socket;
+    BufferPool::Buffer buffer = BufferPool::acquire(BUFFER_SIZE);
+    size_t received = 0;
+    long head_size = read_request_head(client_socket, buffer, received);
+
+    if (head_size == HEAD_TOO_LARGE) {
+        Logger::get_instance().warning("Request head larger than " + std::to_string(MAX_HEAD_SIZE) + " bytes");
+        send_error_response(client_socket, "431 Request Header Fields Too Large");
+        return;
+    }
+    if (head_size == HEAD_TIMED_OUT) {
+        Logger::get_instance().warning("Request head not received within " +
+                                       std::to_string(head_timeout_.count()) + " ms");
+        send_error_response(client_socket, "408 Request Timeout");
+        return;
+    }
+    if (head_size == 0) {
+        Logger::get_instance().error("Failed to read request head from client");
         return;
     }
 
-    buffer[bytes_read] = '\0';
-    std::string request(buffer);
-    Logger::get_instance().debug("Received request:\n" + request);
+    std::string_view head(buffer.data(), head_size);
+    Logger::get_instance().debug("Received request:\n" + std::string(head));
+    if (connection.sampled) {
+        connection.capture.head = std::string(head);
+        connection.capture.request_bytes = received;
+    }
 
-    std::istringstream request_stream(request);
-    std::string method, target, version;
-    request_stream >> method >> target >> version;
+    size_t method_end = head.find(' ');
+    size_t target_end = method_end == std::string_view::npos ? method_end : head.find(' ', method_end + 1);
+    if (target_end == std::string_view::npos) {
+        Logger::get_instance().error("Malformed request line");
+        send_error_response(client_socket, "400 Bad Request");
+        return;
+    }
+    std::string_view method = head.substr(0, method_end);
+    std::string target(head.substr(method_end + 1, target_end - method_end - 1));
 
     if (method == "CONNECT") {
         // Handle HTTPS CONNECT request
@@ -133,88 +371,299 @@ void ProxyServer::handle_connection(int client_socket) {
         }
 
         std::string host = target.substr(0, colon_pos);
-        
-        // Check blocked host
-        if (filter_manager_.is_blocked(host)) {
-            Logger::get_instance().info("HTTPS request blocked - host in blacklist: " + host);
-            send_error_response(client_socket, "403 Forbidden");
+        uint16_t port = 0;
+        if (!parse_port(std::string_view(target).substr(colon_pos + 1), port)) {
+            Logger::get_instance().error("Invalid CONNECT port: " + target);
+            send_error_response(client_socket, "400 Bad Request");
             return;
         }
 
-        int port = std::stoi(target.substr(colon_pos + 1));
+        RequestView request{method, target, target, host, port, head, connection.client_address};
+        FilterResult filtered = request_filters_.run(request);
+        if (filtered.verdict == FilterVerdict::DENY) {
+            Logger::get_instance().info("HTTPS request blocked - " + filtered.reason);
+            send_error_response(client_socket, filtered.status);
+            return;
+        }
 
-        // Create connection to server
-        int target_socket = create_target_connection(host, port);
+        if (connection.sampled) {
+            connection.capture.host = host;
+            connection.capture.port = port;
+        }
+
+        // Create connection to server. No Fast Open: the 200 below must
+        // only go out once the target has actually answered the handshake.
+        UpstreamPool::Lease parent;
+        int target_socket = connect_upstream(host, port, parent, false);
         if (target_socket < 0) {
             Logger::get_instance().error("Failed to connect to target server: " + host + ":" + std::to_string(port));
             send_error_response(client_socket, "502 Bad Gateway");
             return;
         }
 
+        if (parent) {
+            // The parent answers the CONNECT itself; its reply reaches the client through the tunnel
+            if (send(target_socket, buffer.data(), received, MSG_NOSIGNAL) < 0) {
+                Logger::get_instance().error("Failed to forward CONNECT to upstream");
+                close(target_socket);
+                send_error_response(client_socket, "502 Bad Gateway");
+                return;
+            }
+            tunnel_connection(connection, target_socket);
+            return;
+        }
+
         // Send 200 Connection 
         std::string response = "HTTP/1.1 200 Connection Established\r\n\r\n";
-        if (send(client_socket, response.c_str(), response.length(), 0) < 0) {
+        if (send(client_socket, response.c_str(), response.length(), MSG_NOSIGNAL) < 0) {
             Logger::get_instance().error("Failed to send CONNECT response");
             close(target_socket);
-            close(client_socket);
             return;
         }
 
-        tunnel_connection(client_socket, target_socket);
+        // Clients may start the TLS handshake without waiting for the 200
+        size_t early_bytes = received - head_size;
+        if (early_bytes > 0 && send(target_socket, buffer.data() + head_size, early_bytes, MSG_NOSIGNAL) < 0) {
+            close(target_socket);
+            return;
+        }
+
+        tunnel_connection(connection, target_socket);
     } else {
-        // Handle regular HTTP request
-        std::string host = extract_host_from_request(request);
-        if (host.empty()) {
+        // Handle regular HTTP request. An absolute-form target names the
+        // origin itself and a parent ignores Host for it (RFC 7230 5.4), so
+        // the filters must judge the target's authority, and a Host field
+        // that disagrees is refused rather than forwarded.
+        std::string host_field = extract_host_from_request(head);
+        std::string_view absolute = target_authority(target);
+        std::string authority = absolute.empty() ? host_field : std::string(absolute);
+        if (authority.empty()) {
             Logger::get_instance().error("No host found in request");
             send_error_response(client_socket, "400 Bad Request");
             return;
         }
 
-        if (filter_manager_.is_blocked(host)) {
-            Logger::get_instance().info("HTTP request blocked - host in blacklist: " + host);
-            send_error_response(client_socket, "403 Forbidden");
+        std::string host;
+        uint16_t port = 80;
+        if (!split_authority(authority, host, port)) {
+            Logger::get_instance().error("Invalid request authority: " + authority);
+            send_error_response(client_socket, "400 Bad Request");
+            return;
+        }
+        if (!absolute.empty() && !host_field.empty()) {
+            std::string field_host;
+            uint16_t field_port = 80;
+            if (!split_authority(host_field, field_host, field_port) ||
+                strcasecmp(field_host.c_str(), host.c_str()) != 0 || field_port != port) {
+                Logger::get_instance().error("Host " + host_field + " does not match request target " + target);
+                send_error_response(client_socket, "400 Bad Request");
+                return;
+            }
+        }
+
+        RequestView request{method, target, authority, host, port, head, connection.client_address};
+        FilterResult filtered = request_filters_.run(request);
+        if (filtered.verdict == FilterVerdict::DENY) {
+            Logger::get_instance().info("HTTP request blocked - " + filtered.reason);
+            send_error_response(client_socket, filtered.status);
             return;
         }
 
-        int port = 80;
-        size_t colon_pos = host.find(':');
-        if (colon_pos != std::string::npos) {
-            port = std::stoi(host.substr(colon_pos + 1));
-            host = host.substr(0, colon_pos);
+        BodyFramer body;
+        if (!body.init(head)) {
+            Logger::get_instance().error("Invalid request body framing");
+            send_error_response(client_socket, "400 Bad Request");
+            return;
+        }
+        // Body bytes that arrived with the head; anything past the body is dropped
+        size_t early_body = body.consume(buffer.data() + head_size, received - head_size);
+        if (body.failed()) {
+            Logger::get_instance().error("Malformed chunked request body");
+            send_error_response(client_socket, "400 Bad Request");
+            return;
         }
 
-        int target_socket = create_target_connection(host, port);
+        // Rewritten before dialling so a malformed head never costs an
+        // upstream connection. With a pool every request goes to a parent,
+        // which needs the absolute-form target to route it.
+        HeaderRewriter rewriter;
+        HeaderRewriter::Options options;
+        options.keep_absolute_form = upstream_pool_ != nullptr;
+        options.client_address = connection.client_address;
+        options.added_fields = filtered.added_fields;
+        options.removed_fields = &filtered.removed_fields;
+        if (!rewriter.rewrite(std::string_view(buffer.data(), head_size + early_body), options)) {
+            Logger::get_instance().error("Malformed request head");
+            send_error_response(client_socket, "400 Bad Request");
+            return;
+        }
+
+        if (connection.sampled) {
+            connection.capture.host = host;
+            connection.capture.port = port;
+        }
+
+        UpstreamPool::Lease parent;
+        int target_socket = connect_upstream(host, port, parent, true);
         if (target_socket < 0) {
             Logger::get_instance().error("Failed to connect to target server: " + host + ":" + std::to_string(port));
             send_error_response(client_socket, "502 Bad Gateway");
             return;
         }
 
-        if (send(target_socket, request.c_str(), request.length(), 0) < 0) {
+        if (!rewriter.send(target_socket)) {
             Logger::get_instance().error("Failed to forward request to target server");
             close(target_socket);
             send_error_response(client_socket, "502 Bad Gateway");
             return;
         }
 
-        // Forward response from target 
-        char response_buffer[BUFFER_SIZE];
-        int bytes_read;
-        while ((bytes_read = recv(target_socket, response_buffer, sizeof(response_buffer) - 1, 0)) > 0) {
-            response_buffer[bytes_read] = '\0';
-            if (send(client_socket, response_buffer, bytes_read, 0) < 0) {
+        relay_request(connection, target_socket, body);
+    }
+}
+
+void ProxyServer::relay_request(Connection& connection, int target_socket, BodyFramer& body) {
+    int client_socket = connection.socket;
+    fcntl(client_socket, F_SETFL, fcntl(client_socket, F_GETFL) | O_NONBLOCK);
+    fcntl(target_socket, F_SETFL, fcntl(target_socket, F_GETFL) | O_NONBLOCK);
+
+    // One bounded buffer per direction: a side is only read once its buffer
+    // has drained, so a slow reader throttles the writer instead of memory growing
+    BufferPool::Buffer upstream_buffer = BufferPool::acquire(BUFFER_SIZE);
+    BufferPool::Buffer downstream_buffer = BufferPool::acquire(BUFFER_SIZE);
+    size_t upstream_start = 0, upstream_end = 0;
+    size_t downstream_start = 0, downstream_end = 0;
+    bool response_open = true;
+
+    while (response_open || downstream_start < downstream_end) {
+        struct pollfd fds[2] = {{client_socket, 0, 0}, {target_socket, 0, 0}};
+        if (!body.done() && upstream_end == 0) {
+            fds[0].events |= POLLIN;
+        }
+        if (downstream_start < downstream_end) {
+            fds[0].events |= POLLOUT;
+        }
+        if (upstream_start < upstream_end) {
+            fds[1].events |= POLLOUT;
+        }
+        if (response_open && downstream_end == 0) {
+            fds[1].events |= POLLIN;
+        }
+        // Without interest in the upstream, its hangup must not wake the loop.
+        // The client stays polled: a full hangup there (or drain() shutting
+        // it down) ends the relay even while the upstream is silent.
+        if (fds[1].events == 0) {
+            fds[1].fd = -1;
+        }
+
+        int ready = poll(fds, 2, TUNNEL_IDLE_SHRINK_SECONDS * 1000);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Logger::get_instance().error("Poll error while relaying request");
+            break;
+        }
+        if (ready == 0) {
+            // Idle: give large buffers back to the pool
+            if (upstream_end == 0) {
+                upstream_buffer.shrink();
+            }
+            if (downstream_end == 0) {
+                downstream_buffer.shrink();
+            }
+            continue;
+        }
+        if ((fds[0].revents & POLLERR) || (fds[1].revents & POLLERR)) {
+            break;
+        }
+        if ((fds[0].revents & POLLHUP) && !(fds[0].events & POLLIN)) {
+            Logger::get_instance().warning("Client went away before the response was relayed");
+            break;
+        }
+
+        // Request body: client to upstream
+        if ((fds[0].events & POLLIN) && (fds[0].revents & (POLLIN | POLLHUP))) {
+            ssize_t bytes = recv(client_socket, upstream_buffer.data(), upstream_buffer.capacity(), 0);
+            if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EINTR)) {
+                Logger::get_instance().warning("Client closed before sending the whole request body");
+                break;
+            }
+            if (bytes > 0) {
+                upstream_end = body.consume(upstream_buffer.data(), bytes);
+                if (body.failed()) {
+                    Logger::get_instance().error("Malformed chunked request body");
+                    break;
+                }
+                account_relayed(connection, upstream_end, false);
+                if (static_cast<size_t>(bytes) == upstream_buffer.capacity()) {
+                    upstream_buffer.grow(upstream_end);
+                }
+            }
+        }
+        if (upstream_start < upstream_end) {
+            ssize_t bytes = send(target_socket, upstream_buffer.data() + upstream_start,
+                                 upstream_end - upstream_start, MSG_NOSIGNAL);
+            if (bytes < 0 && errno != EAGAIN && errno != EINTR) {
+                Logger::get_instance().error("Failed to forward request body to target server");
+                break;
+            }
+            if (bytes > 0 && (upstream_start += bytes) == upstream_end) {
+                upstream_start = upstream_end = 0;
+            }
+        }
+
+        // Response: upstream to client
+        if ((fds[1].events & POLLIN) && (fds[1].revents & (POLLIN | POLLHUP))) {
+            ssize_t bytes = recv(target_socket, downstream_buffer.data(), downstream_buffer.capacity(), 0);
+            if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EINTR)) {
+                response_open = false;
+            } else if (bytes > 0) {
+                downstream_end = bytes;
+                account_relayed(connection, bytes, true);
+                if (static_cast<size_t>(bytes) == downstream_buffer.capacity()) {
+                    downstream_buffer.grow(downstream_end);
+                }
+            }
+        }
+        if (downstream_start < downstream_end) {
+            ssize_t bytes = send(client_socket, downstream_buffer.data() + downstream_start,
+                                 downstream_end - downstream_start, MSG_NOSIGNAL);
+            if (bytes < 0 && errno != EAGAIN && errno != EINTR) {
                 Logger::get_instance().error("Failed to send response to client");
                 break;
             }
+            if (bytes > 0 && (downstream_start += bytes) == downstream_end) {
+                downstream_start = downstream_end = 0;
+            }
         }
+    }
+
+    close(target_socket);
+}
+
+int ProxyServer::connect_upstream(const std::string& host, int port, UpstreamPool::Lease& parent, bool fast_open) {
+    if (!upstream_pool_) {
+        return create_target_connection(host, port, fast_open);
+    }
 
-        close(target_socket);
+    parent = upstream_pool_->select(host);
+    if (!parent) {
+        Logger::get_instance().error("No healthy upstream available for " + host);
+        return -1;
     }
 
-    close(client_socket);
+    // The result feeds the parent's health, so it must reflect a real handshake
+    int sock = create_target_connection(parent->host, parent->port, false);
+    if (sock < 0) {
+        upstream_pool_->report_failure(*parent);
+    } else {
+        upstream_pool_->report_success(*parent);
+    }
+    return sock;
 }
 
-int ProxyServer::create_target_connection(const std::string& host, int port) {
+int ProxyServer::create_target_connection(const std::string& host, int port, bool fast_open) {
     struct addrinfo hints, *result;
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_UNSPEC;
@@ -231,6 +680,7 @@ int ProxyServer::create_target_connection(const std::string& host, int port) {
         freeaddrinfo(result);
         return -1;
     }
+    socket_profile_.apply_upstream(sock, fast_open);
 
     if (connect(sock, result->ai_addr, result->ai_addrlen) < 0) {
         Logger::get_instance().error("Failed to connect to target server");
@@ -243,57 +693,93 @@ int ProxyServer::create_target_connection(const std::string& host, int port) {
     return sock;
 }
 
-void ProxyServer::send_error_response(int socket, const std::string& status) {
-    std::string response = "HTTP/1.1 " + status + "\r\n"
+void ProxyServer::send_error_response(int socket, const char* status) {
+    char response[256];
+    int length = snprintf(response, sizeof(response),
+                          "HTTP/1.1 %s\r\n"
                           "Content-Type: text/plain\r\n"
-                          "Content-Length: " + std::to_string(status.length()) + "\r\n\r\n" +
-                          status;
-    send(socket, response.c_str(), response.length(), 0);
+                          "Content-Length: %zu\r\n\r\n%s",
+                          status, strlen(status), status);
+    if (length > 0) {
+        send(socket, response, std::min<size_t>(length, sizeof(response) - 1), MSG_NOSIGNAL);
+    }
 }
 
-void ProxyServer::tunnel_connection(int client_socket, int target_socket) {
+void ProxyServer::tunnel_connection(Connection& connection, int target_socket) {
+    int client_socket = connection.socket;
     fd_set read_fds;
-    char buffer[BUFFER_SIZE];
+    // One buffer per direction so bulk transfers can grow independently
+    BufferPool::Buffer upstream_buffer = BufferPool::acquire(BUFFER_SIZE);
+    BufferPool::Buffer downstream_buffer = BufferPool::acquire(BUFFER_SIZE);
     
     while (true) {
         FD_ZERO(&read_fds);
         FD_SET(client_socket, &read_fds);
         FD_SET(target_socket, &read_fds);
         
+        struct timeval idle_timeout;
+        idle_timeout.tv_sec = TUNNEL_IDLE_SHRINK_SECONDS;
+        idle_timeout.tv_usec = 0;
+
         int max_fd = std::max(client_socket, target_socket);
-        if (select(max_fd + 1, &read_fds, nullptr, nullptr, nullptr) < 0) {
+        int ready = select(max_fd + 1, &read_fds, nullptr, nullptr, &idle_timeout);
+        if (ready < 0) {
             Logger::get_instance().error("Select error in tunnel");
             break;
         }
 
+        if (ready == 0) {
+            // Idle tunnel: give large buffers back to the pool
+            upstream_buffer.shrink();
+            downstream_buffer.shrink();
+            continue;
+        }
+
         // Client to target
         if (FD_ISSET(client_socket, &read_fds)) {
-            int bytes = recv(client_socket, buffer, sizeof(buffer), 0);
+            int bytes = recv(client_socket, upstream_buffer.data(), upstream_buffer.capacity(), 0);
             if (bytes <= 0) break;
-            if (send(target_socket, buffer, bytes, 0) <= 0) break;
+            if (send(target_socket, upstream_buffer.data(), bytes, MSG_NOSIGNAL) <= 0) break;
+            account_relayed(connection, bytes, false);
+            if (static_cast<size_t>(bytes) == upstream_buffer.capacity()) {
+                upstream_buffer.grow();
+            }
         }
 
         // Target to client
         if (FD_ISSET(target_socket, &read_fds)) {
-            int bytes = recv(target_socket, buffer, sizeof(buffer), 0);
+            int bytes = recv(target_socket, downstream_buffer.data(), downstream_buffer.capacity(), 0);
             if (bytes <= 0) break;
-            if (send(client_socket, buffer, bytes, 0) <= 0) break;
+            if (send(client_socket, downstream_buffer.data(), bytes, MSG_NOSIGNAL) <= 0) break;
+            account_relayed(connection, bytes, true);
+            if (static_cast<size_t>(bytes) == downstream_buffer.capacity()) {
+                downstream_buffer.grow();
+            }
         }
     }
 
     close(target_socket);
 }
 
-std::string ProxyServer::extract_host_from_request(const std::string& request) {
-    std::regex host_regex("Host:\\s*([^\\r\\n]+)");
-    std::smatch match;
-    if (std::regex_search(request, match, host_regex)) {
-        std::string host = match[1];
-        size_t colon_pos = host.find(':');
-        if (colon_pos != std::string::npos) {
-            host = host.substr(0, colon_pos);
-        }
-        return host;
+void ProxyServer::account_relayed(Connection& connection, size_t bytes, bool to_client) {
+    if (connection.sampled) {
+        (to_client ? connection.capture.response_bytes : connection.capture.request_bytes) += bytes;
+    }
+
+    // Sleep off any bandwidth debt instead of polling the bucket
+    std::chrono::nanoseconds delay = connection.lease.charge_bytes(bytes);
+    if (delay.count() > 0) {
+        std::this_thread::sleep_for(delay);
+    }
+}
+
+std::string ProxyServer::extract_host_from_request(std::string_view request) {
+    // Only a whole field named Host, not X-Forwarded-Host and the like
+    static const std::regex host_regex("\\r\\nHost:[ \\t]*([^\\r\\n]*[^\\r\\n \\t])", std::regex::icase);
+    std::cmatch match;
+    if (std::regex_search(request.data(), request.data() + request.size(), match, host_regex)) {
+        // Keep any port; the caller splits it off
+        return match[1];
     }
     return "";
 } 
\ No newline at end of file
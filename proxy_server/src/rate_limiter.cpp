@@ -0,0 +1,167 @@
+#include "rate_limiter.hpp"
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace {
+constexpr int64_t TOKEN_SCALE = 1000;
+constexpr int64_t NS_PER_SECOND = 1000000000;
+}
+
+void TokenBucket::configure(double rate_per_second, double burst) {
+    rate_ = rate_per_second;
+    // Without an explicit burst, allow one second's worth
+    capacity_ = static_cast<int64_t>((burst > 0 ? burst : rate_per_second) * TOKEN_SCALE);
+    tokens_ = capacity_;
+    last_refill_ns_ = RateLimiter::now_ns();
+}
+
+void TokenBucket::refill(int64_t now_ns) {
+    int64_t last = last_refill_ns_.load(std::memory_order_relaxed);
+    while (now_ns > last) {
+        // Whoever advances the timestamp owns the refill for that interval
+        if (!last_refill_ns_.compare_exchange_weak(last, now_ns, std::memory_order_relaxed)) {
+            continue;
+        }
+        double elapsed = static_cast<double>(now_ns - last);
+        double added = std::min(elapsed * rate_ / NS_PER_SECOND * TOKEN_SCALE, static_cast<double>(capacity_));
+        int64_t add = static_cast<int64_t>(added);
+
+        int64_t current = tokens_.load(std::memory_order_relaxed);
+        int64_t updated;
+        do {
+            updated = std::min(current + add, capacity_);
+        } while (!tokens_.compare_exchange_weak(current, updated, std::memory_order_relaxed));
+        return;
+    }
+}
+
+bool TokenBucket::try_consume(double amount, int64_t now_ns) {
+    if (unlimited()) {
+        return true;
+    }
+    refill(now_ns);
+
+    int64_t needed = static_cast<int64_t>(amount * TOKEN_SCALE);
+    int64_t current = tokens_.load(std::memory_order_relaxed);
+    while (current >= needed) {
+        if (tokens_.compare_exchange_weak(current, current - needed, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::chrono::nanoseconds TokenBucket::consume(double amount, int64_t now_ns) {
+    if (unlimited()) {
+        return std::chrono::nanoseconds(0);
+    }
+    refill(now_ns);
+
+    int64_t needed = static_cast<int64_t>(amount * TOKEN_SCALE);
+    int64_t remaining = tokens_.fetch_sub(needed, std::memory_order_relaxed) - needed;
+    if (remaining >= 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    double debt = static_cast<double>(-remaining) / TOKEN_SCALE;
+    return std::chrono::nanoseconds(static_cast<int64_t>(debt / rate_ * NS_PER_SECOND));
+}
+
+double TokenBucket::available(int64_t now_ns) {
+    if (unlimited()) {
+        return std::numeric_limits<double>::infinity();
+    }
+    refill(now_ns);
+    return static_cast<double>(tokens_.load(std::memory_order_relaxed)) / TOKEN_SCALE;
+}
+
+RateLimiter::RateLimiter(const Config& config) : config_(config) {}
+
+int64_t RateLimiter::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::shared_ptr<RateLimiter::ClientState> RateLimiter::client(const std::string& address) {
+    Shard& shard = shards_[std::hash<std::string>{}(address) % NUM_SHARDS];
+    int64_t now = now_ns();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (++shard.lookups % EVICTION_INTERVAL == 0) {
+        evict_idle(shard, now);
+    }
+
+    auto& state = shard.clients[address];
+    if (!state) {
+        state = std::make_shared<ClientState>();
+        state->requests.configure(config_.requests_per_second, config_.request_burst);
+        state->bytes.configure(config_.bytes_per_second, config_.byte_burst);
+    }
+    state->last_seen_ns.store(now, std::memory_order_relaxed);
+    return state;
+}
+
+RateLimiter::Lease RateLimiter::open_connection(const std::string& address) {
+    std::shared_ptr<ClientState> state = client(address);
+    if (!try_open_connection(*state)) {
+        return Lease();
+    }
+    return Lease(this, std::move(state));
+}
+
+bool RateLimiter::try_open_connection(ClientState& state) {
+    int previous = state.connections.fetch_add(1, std::memory_order_relaxed);
+    if (config_.max_connections > 0 && previous >= config_.max_connections) {
+        state.connections.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (!state.requests.try_consume(1, now_ns())) {
+        state.connections.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void RateLimiter::close_connection(ClientState& state) {
+    state.connections.fetch_sub(1, std::memory_order_relaxed);
+    state.last_seen_ns.store(now_ns(), std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds RateLimiter::charge_bytes(ClientState& state, size_t bytes) {
+    return state.bytes.consume(static_cast<double>(bytes), now_ns());
+}
+
+void RateLimiter::evict_idle() {
+    int64_t now = now_ns();
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict_idle(shard, now);
+    }
+}
+
+void RateLimiter::evict_idle(Shard& shard, int64_t now) {
+    int64_t idle_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(config_.idle_timeout).count();
+    for (auto it = shard.clients.begin(); it != shard.clients.end();) {
+        const ClientState& state = *it->second;
+        if (state.connections.load(std::memory_order_relaxed) == 0 &&
+            now - state.last_seen_ns.load(std::memory_order_relaxed) >= idle_ns) {
+            it = shard.clients.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::vector<RateLimiter::ClientSnapshot> RateLimiter::snapshot() const {
+    std::vector<ClientSnapshot> result;
+    int64_t now = now_ns();
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& [address, state] : shard.clients) {
+            result.push_back({address, state->connections.load(std::memory_order_relaxed),
+                              state->requests.available(now), state->bytes.available(now)});
+        }
+    }
+    return result;
+}
@@ -0,0 +1,182 @@
+#include "socket_handoff.hpp"
+#include "logger.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace {
+
+constexpr char HANDOFF_MESSAGE = 'L';
+constexpr char ACK_MESSAGE = 'A';
+
+bool make_address(const std::string& path, struct sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        Logger::get_instance().error("Handoff socket path too long: " + path);
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+} // namespace
+
+SocketHandoff::SocketHandoff(const std::string& path) : path_(path) {}
+
+SocketHandoff::~SocketHandoff() {
+    stopping_ = true;
+    if (control_socket_ >= 0) {
+        // Wakes the blocking accept in serve_loop
+        shutdown(control_socket_, SHUT_RDWR);
+    }
+    if (serve_thread_.joinable()) {
+        serve_thread_.join();
+    }
+    if (control_socket_ >= 0) {
+        close(control_socket_);
+    }
+    if (takeover_channel_ >= 0) {
+        close(takeover_channel_);
+    }
+}
+
+bool SocketHandoff::send_fd(int channel, int fd) {
+    char payload = HANDOFF_MESSAGE;
+    struct iovec iov = {&payload, 1};
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+    return sendmsg(channel, &message, MSG_NOSIGNAL) == 1;
+}
+
+int SocketHandoff::receive_fd(int channel) {
+    char payload = 0;
+    struct iovec iov = {&payload, 1};
+
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if (recvmsg(channel, &message, MSG_CMSG_CLOEXEC) != 1 || payload != HANDOFF_MESSAGE) {
+        return -1;
+    }
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS ||
+        header->cmsg_len != CMSG_LEN(sizeof(int))) {
+        return -1;
+    }
+
+    int fd;
+    memcpy(&fd, CMSG_DATA(header), sizeof(int));
+    return fd;
+}
+
+int SocketHandoff::take_over() {
+    struct sockaddr_un address;
+    if (!make_address(path_, address)) {
+        return -1;
+    }
+
+    int channel = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (channel < 0) {
+        return -1;
+    }
+    if (connect(channel, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(channel);
+        return -1;
+    }
+
+    int listener = receive_fd(channel);
+    if (listener < 0) {
+        Logger::get_instance().error("Failed to receive listening socket from " + path_);
+        close(channel);
+        return -1;
+    }
+
+    takeover_channel_ = channel;
+    Logger::get_instance().info("Took over listening socket from running proxy");
+    return listener;
+}
+
+void SocketHandoff::acknowledge() {
+    if (takeover_channel_ < 0) {
+        return;
+    }
+    char ack = ACK_MESSAGE;
+    if (send(takeover_channel_, &ack, 1, MSG_NOSIGNAL) != 1) {
+        Logger::get_instance().error("Failed to acknowledge socket handoff");
+    }
+    close(takeover_channel_);
+    takeover_channel_ = -1;
+}
+
+bool SocketHandoff::serve(int listener, std::function<void()> on_handoff) {
+    struct sockaddr_un address;
+    if (!make_address(path_, address)) {
+        return false;
+    }
+
+    control_socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (control_socket_ < 0) {
+        return false;
+    }
+
+    // A previous process may still hold the old path; the new binding replaces it
+    unlink(path_.c_str());
+    if (bind(control_socket_, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(control_socket_, 1) < 0) {
+        Logger::get_instance().error("Failed to listen on handoff socket " + path_);
+        close(control_socket_);
+        control_socket_ = -1;
+        return false;
+    }
+
+    serve_thread_ = std::thread(&SocketHandoff::serve_loop, this, listener, std::move(on_handoff));
+    return true;
+}
+
+void SocketHandoff::serve_loop(int listener, std::function<void()> on_handoff) {
+    while (!stopping_) {
+        int channel = accept4(control_socket_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (channel < 0) {
+            continue;
+        }
+
+        Logger::get_instance().info("Upgrade requested, handing off listening socket");
+        char ack = 0;
+        bool acknowledged = send_fd(channel, listener) &&
+                            recv(channel, &ack, 1, 0) == 1 && ack == ACK_MESSAGE;
+        close(channel);
+
+        if (!acknowledged) {
+            // The successor died before accepting; keep serving
+            Logger::get_instance().error("Successor did not acknowledge socket handoff");
+            continue;
+        }
+
+        Logger::get_instance().info("Successor is accepting, draining connections");
+        on_handoff();
+        return;
+    }
+}
@@ -0,0 +1,162 @@
+#include "socket_profile.hpp"
+#include "logger.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr int FAST_OPEN_QUEUE = 256;
+constexpr int BULK_BUFFER_SIZE = 4 * 1024 * 1024;
+constexpr int LATENCY_NOT_SENT_LOWAT = 16384;
+constexpr int LATENCY_BUSY_POLL_US = 50;
+
+void set_option(int socket, int level, int option, int value, const char* label, bool listener) {
+    if (setsockopt(socket, level, option, &value, sizeof(value)) == 0) {
+        return;
+    }
+    // Per-connection failures repeat for every socket, so keep them out of the normal log
+    std::string message = std::string("Failed to set ") + label + ": " + strerror(errno);
+    if (listener) {
+        Logger::get_instance().warning(message);
+    } else {
+        Logger::get_instance().debug(message);
+    }
+}
+
+bool parse_int(const std::string& text, int& value) {
+    char* end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || parsed < 0 || parsed > INT32_MAX) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool named_profile(const std::string& name, SocketProfile& profile) {
+    profile = SocketProfile();
+    profile.name = name;
+    if (name == "default") {
+        return true;
+    }
+    if (name == "latency") {
+        profile.no_delay = true;
+        profile.fast_open_queue = FAST_OPEN_QUEUE;
+        profile.fast_open_connect = true;
+        profile.defer_accept_seconds = 1;
+        profile.not_sent_lowat = LATENCY_NOT_SENT_LOWAT;
+        profile.busy_poll_us = LATENCY_BUSY_POLL_US;
+        return true;
+    }
+    if (name == "bulk") {
+        profile.fast_open_queue = FAST_OPEN_QUEUE;
+        profile.fast_open_connect = true;
+        profile.defer_accept_seconds = 1;
+        profile.send_buffer = BULK_BUFFER_SIZE;
+        profile.receive_buffer = BULK_BUFFER_SIZE;
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+bool SocketProfile::parse(const std::string& spec, SocketProfile& profile) {
+    size_t comma = spec.find(',');
+    if (!named_profile(spec.substr(0, comma), profile)) {
+        return false;
+    }
+
+    while (comma != std::string::npos) {
+        size_t start = comma + 1;
+        comma = spec.find(',', start);
+        std::string item = spec.substr(start, comma == std::string::npos ? comma : comma - start);
+        size_t equals = item.find('=');
+        int value = 0;
+        if (equals == std::string::npos || !parse_int(item.substr(equals + 1), value)) {
+            return false;
+        }
+
+        std::string key = item.substr(0, equals);
+        if (key == "nodelay") {
+            profile.no_delay = value != 0;
+        } else if (key == "fastopen") {
+            profile.fast_open_queue = value;
+        } else if (key == "fastopen-connect") {
+            profile.fast_open_connect = value != 0;
+        } else if (key == "defer-accept") {
+            profile.defer_accept_seconds = value;
+        } else if (key == "sndbuf") {
+            profile.send_buffer = value;
+        } else if (key == "rcvbuf") {
+            profile.receive_buffer = value;
+        } else if (key == "notsent-lowat") {
+            profile.not_sent_lowat = value;
+        } else if (key == "busy-poll") {
+            profile.busy_poll_us = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string SocketProfile::describe() const {
+    return name + " (nodelay=" + std::to_string(no_delay) +
+           " fastopen=" + std::to_string(fast_open_queue) +
+           " fastopen-connect=" + std::to_string(fast_open_connect) +
+           " defer-accept=" + std::to_string(defer_accept_seconds) +
+           " sndbuf=" + std::to_string(send_buffer) +
+           " rcvbuf=" + std::to_string(receive_buffer) +
+           " notsent-lowat=" + std::to_string(not_sent_lowat) +
+           " busy-poll=" + std::to_string(busy_poll_us) + ")";
+}
+
+void SocketProfile::apply_listener(int socket) const {
+    // Accepted sockets inherit buffer sizes; the receive buffer also fixes
+    // the window scale offered in the handshake, so it has to be set here
+    if (send_buffer > 0) {
+        set_option(socket, SOL_SOCKET, SO_SNDBUF, send_buffer, "SO_SNDBUF", true);
+    }
+    if (receive_buffer > 0) {
+        set_option(socket, SOL_SOCKET, SO_RCVBUF, receive_buffer, "SO_RCVBUF", true);
+    }
+    if (fast_open_queue > 0) {
+        set_option(socket, IPPROTO_TCP, TCP_FASTOPEN, fast_open_queue, "TCP_FASTOPEN", true);
+    }
+    if (defer_accept_seconds > 0) {
+        // Clients speak first, so wake accept only once the request arrives
+        set_option(socket, IPPROTO_TCP, TCP_DEFER_ACCEPT, defer_accept_seconds, "TCP_DEFER_ACCEPT", true);
+    }
+}
+
+void SocketProfile::apply_client(int socket) const {
+    if (no_delay) {
+        set_option(socket, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", false);
+    }
+    if (not_sent_lowat > 0) {
+        set_option(socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, not_sent_lowat, "TCP_NOTSENT_LOWAT", false);
+    }
+    if (busy_poll_us > 0) {
+        set_option(socket, SOL_SOCKET, SO_BUSY_POLL, busy_poll_us, "SO_BUSY_POLL", false);
+    }
+}
+
+void SocketProfile::apply_upstream(int socket, bool allow_fast_open_connect) const {
+    if (send_buffer > 0) {
+        set_option(socket, SOL_SOCKET, SO_SNDBUF, send_buffer, "SO_SNDBUF", false);
+    }
+    if (receive_buffer > 0) {
+        set_option(socket, SOL_SOCKET, SO_RCVBUF, receive_buffer, "SO_RCVBUF", false);
+    }
+    if (fast_open_connect && allow_fast_open_connect) {
+        // connect() returns at once and the request rides on the SYN when a cookie is cached
+        set_option(socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1, "TCP_FASTOPEN_CONNECT", false);
+    }
+    apply_client(socket);
+}
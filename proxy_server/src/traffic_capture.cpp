@@ -0,0 +1,137 @@
+#include "traffic_capture.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace {
+
+template <typename T>
+char* put(char* out, T value) {
+    memcpy(out, &value, sizeof(value));
+    return out + sizeof(value);
+}
+
+template <typename T>
+const char* get(const char* in, T& value) {
+    memcpy(&value, in, sizeof(value));
+    return in + sizeof(value);
+}
+
+void encode(const TrafficCapture::RecordHeader& header, char* out) {
+    out = put(out, header.offset_ns);
+    out = put(out, header.request_bytes);
+    out = put(out, header.response_bytes);
+    out = put(out, header.duration_us);
+    out = put(out, header.port);
+    out = put(out, header.host_size);
+    put(out, header.head_size);
+}
+
+void decode(const char* in, TrafficCapture::RecordHeader& header) {
+    in = get(in, header.offset_ns);
+    in = get(in, header.request_bytes);
+    in = get(in, header.response_bytes);
+    in = get(in, header.duration_us);
+    in = get(in, header.port);
+    in = get(in, header.host_size);
+    get(in, header.head_size);
+}
+
+} // namespace
+
+TrafficCapture::TrafficCapture(const std::string& path, double sample_rate)
+    : file_(fopen(path.c_str(), "wb")), sample_rate_(sample_rate), start_(std::chrono::steady_clock::now()) {
+    if (!file_) {
+        Logger::get_instance().error("Failed to open capture file: " + path);
+        return;
+    }
+
+    FileHeader header = {MAGIC, VERSION};
+    fwrite(&header, sizeof(header), 1, file_);
+    Logger::get_instance().info("Capturing traffic to " + path + " (sample rate " + std::to_string(sample_rate) + ")");
+}
+
+TrafficCapture::~TrafficCapture() {
+    if (file_) {
+        fclose(file_);
+    }
+}
+
+bool TrafficCapture::should_sample() const {
+    if (sample_rate_ >= 1.0) {
+        return true;
+    }
+    if (sample_rate_ <= 0.0) {
+        return false;
+    }
+    thread_local std::minstd_rand generator(std::random_device{}());
+    return std::uniform_real_distribution<double>(0.0, 1.0)(generator) < sample_rate_;
+}
+
+uint64_t TrafficCapture::offset_now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void TrafficCapture::record(const Record& record) {
+    if (!file_) {
+        return;
+    }
+
+    RecordHeader header;
+    header.offset_ns = record.offset_ns;
+    header.request_bytes = record.request_bytes;
+    header.response_bytes = record.response_bytes;
+    header.duration_us = record.duration_us;
+    header.port = record.port;
+    header.host_size = static_cast<uint16_t>(std::min<size_t>(record.host.size(), UINT16_MAX));
+    header.head_size = static_cast<uint32_t>(std::min(record.head.size(), MAX_HEAD_SIZE));
+
+    char encoded[RECORD_HEADER_SIZE];
+    encode(header, encoded);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    fwrite(encoded, sizeof(encoded), 1, file_);
+    fwrite(record.host.data(), 1, header.host_size, file_);
+    fwrite(record.head.data(), 1, header.head_size, file_);
+    fflush(file_);
+}
+
+bool TrafficCapture::read_all(const std::string& path, std::vector<Record>& records) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    FileHeader file_header;
+    if (fread(&file_header, sizeof(file_header), 1, file) != 1 ||
+        file_header.magic != MAGIC || file_header.version != VERSION) {
+        fclose(file);
+        return false;
+    }
+
+    char encoded[RECORD_HEADER_SIZE];
+    while (fread(encoded, sizeof(encoded), 1, file) == 1) {
+        RecordHeader header;
+        decode(encoded, header);
+        Record record;
+        record.offset_ns = header.offset_ns;
+        record.request_bytes = header.request_bytes;
+        record.response_bytes = header.response_bytes;
+        record.duration_us = header.duration_us;
+        record.port = header.port;
+        record.host.resize(header.host_size);
+        record.head.resize(header.head_size);
+        if (fread(&record.host[0], 1, header.host_size, file) != header.host_size ||
+            fread(&record.head[0], 1, header.head_size, file) != header.head_size) {
+            break;  // torn final record from a proxy that was killed mid-write
+        }
+        records.push_back(std::move(record));
+    }
+
+    fclose(file);
+    // Records are written on completion; replay needs arrival order
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& a, const Record& b) { return a.offset_ns < b.offset_ns; });
+    return true;
+}
@@ -0,0 +1,237 @@
+#include "upstream_pool.hpp"
+#include "logger.hpp"
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// FNV-1a followed by a 64-bit finalizer so nearby keys spread over the ring
+uint64_t hash_key(const std::string& key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+bool probe_connect(const std::string& host, int port, std::chrono::milliseconds timeout) {
+    struct addrinfo hints, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    std::string port_str = std::to_string(port);
+    if (getaddrinfo(host.c_str(), port_str.c_str(), &hints, &result) != 0) {
+        return false;
+    }
+
+    int sock = socket(result->ai_family, result->ai_socktype | SOCK_NONBLOCK, result->ai_protocol);
+    bool connected = false;
+    if (sock >= 0) {
+        if (connect(sock, result->ai_addr, result->ai_addrlen) == 0) {
+            connected = true;
+        } else if (errno == EINPROGRESS) {
+            struct pollfd pfd = {sock, POLLOUT, 0};
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            connected = poll(&pfd, 1, static_cast<int>(timeout.count())) == 1 &&
+                        getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_len) == 0 &&
+                        error == 0;
+        }
+        close(sock);
+    }
+
+    freeaddrinfo(result);
+    return connected;
+}
+
+} // namespace
+
+UpstreamPool::UpstreamPool(Policy policy) : policy_(policy) {}
+
+UpstreamPool::~UpstreamPool() {
+    if (health_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(health_mutex_);
+            stopping_ = true;
+        }
+        health_cv_.notify_all();
+        health_thread_.join();
+    }
+}
+
+bool UpstreamPool::parse_policy(const std::string& name, Policy& policy) {
+    if (name == "weighted") {
+        policy = Policy::WEIGHTED;
+    } else if (name == "least-conn") {
+        policy = Policy::LEAST_CONNECTIONS;
+    } else if (name == "hash") {
+        policy = Policy::CONSISTENT_HASH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void UpstreamPool::add_upstream(const std::string& host, int port, int weight) {
+    auto upstream = std::make_unique<Upstream>();
+    upstream->host = host;
+    upstream->port = port;
+    upstream->weight = std::max(weight, 1);
+    upstreams_.push_back(std::move(upstream));
+    build_ring();
+    Logger::get_instance().info("Added upstream " + host + ":" + std::to_string(port) +
+                                " (weight " + std::to_string(std::max(weight, 1)) + ")");
+}
+
+void UpstreamPool::build_ring() {
+    ring_.clear();
+    for (size_t i = 0; i < upstreams_.size(); ++i) {
+        const Upstream& upstream = *upstreams_[i];
+        std::string base = upstream.host + ":" + std::to_string(upstream.port) + "#";
+        for (int point = 0; point < upstream.weight * HASH_POINTS_PER_WEIGHT; ++point) {
+            ring_.emplace_back(hash_key(base + std::to_string(point)), i);
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+UpstreamPool::Lease UpstreamPool::select(const std::string& target_host) {
+    Upstream* chosen = nullptr;
+    switch (policy_) {
+        case Policy::WEIGHTED:
+            chosen = select_weighted();
+            break;
+        case Policy::LEAST_CONNECTIONS:
+            chosen = select_least_connections();
+            break;
+        case Policy::CONSISTENT_HASH:
+            chosen = select_consistent_hash(target_host);
+            break;
+    }
+    return chosen ? Lease(chosen) : Lease();
+}
+
+UpstreamPool::Upstream* UpstreamPool::select_weighted() {
+    // Smooth weighted round robin: interleaves picks instead of bursting
+    std::lock_guard<std::mutex> lock(mutex_);
+    Upstream* best = nullptr;
+    int total = 0;
+    for (auto& upstream : upstreams_) {
+        if (!is_healthy(*upstream)) {
+            continue;
+        }
+        upstream->current_weight += upstream->weight;
+        total += upstream->weight;
+        if (!best || upstream->current_weight > best->current_weight) {
+            best = upstream.get();
+        }
+    }
+    if (best) {
+        best->current_weight -= total;
+    }
+    return best;
+}
+
+UpstreamPool::Upstream* UpstreamPool::select_least_connections() {
+    Upstream* best = nullptr;
+    double best_load = std::numeric_limits<double>::max();
+    for (auto& upstream : upstreams_) {
+        if (!is_healthy(*upstream)) {
+            continue;
+        }
+        double load = static_cast<double>(upstream->active_connections.load(std::memory_order_relaxed)) /
+                      upstream->weight;
+        if (load < best_load) {
+            best = upstream.get();
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+UpstreamPool::Upstream* UpstreamPool::select_consistent_hash(const std::string& target_host) {
+    if (ring_.empty()) {
+        return nullptr;
+    }
+
+    // Walk clockwise past ejected upstreams so only their share of hosts moves
+    auto start = std::upper_bound(ring_.begin(), ring_.end(),
+                                  std::make_pair(hash_key(target_host), size_t(0)));
+    for (size_t step = 0; step < ring_.size(); ++step) {
+        size_t position = (static_cast<size_t>(start - ring_.begin()) + step) % ring_.size();
+        Upstream* upstream = upstreams_[ring_[position].second].get();
+        if (is_healthy(*upstream)) {
+            return upstream;
+        }
+    }
+    return nullptr;
+}
+
+void UpstreamPool::report_success(Upstream& upstream) {
+    upstream.consecutive_failures.store(0, std::memory_order_relaxed);
+    if (upstream.ejected_until_ns.exchange(0, std::memory_order_relaxed) != 0) {
+        Logger::get_instance().info("Upstream restored: " + upstream.host + ":" + std::to_string(upstream.port));
+    }
+}
+
+void UpstreamPool::report_failure(Upstream& upstream) {
+    int failures = upstream.consecutive_failures.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (failures >= EJECT_AFTER_FAILURES) {
+        int64_t until = steady_now_ns() +
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(EJECT_DURATION).count();
+        if (upstream.ejected_until_ns.exchange(until, std::memory_order_relaxed) == 0) {
+            Logger::get_instance().warning("Upstream ejected after " + std::to_string(failures) +
+                                           " failures: " + upstream.host + ":" + std::to_string(upstream.port));
+        }
+    }
+}
+
+bool UpstreamPool::is_healthy(const Upstream& upstream) const {
+    int64_t until = upstream.ejected_until_ns.load(std::memory_order_relaxed);
+    return until == 0 || steady_now_ns() >= until;
+}
+
+void UpstreamPool::start_health_checks(std::chrono::milliseconds interval) {
+    if (!health_thread_.joinable() && interval.count() > 0) {
+        health_thread_ = std::thread(&UpstreamPool::health_check_loop, this, interval);
+    }
+}
+
+void UpstreamPool::probe_all() {
+    for (auto& upstream : upstreams_) {
+        if (probe_connect(upstream->host, upstream->port, PROBE_TIMEOUT)) {
+            report_success(*upstream);
+        } else {
+            report_failure(*upstream);
+        }
+    }
+}
+
+void UpstreamPool::health_check_loop(std::chrono::milliseconds interval) {
+    std::unique_lock<std::mutex> lock(health_mutex_);
+    while (!stopping_) {
+        lock.unlock();
+        probe_all();
+        lock.lock();
+        health_cv_.wait_for(lock, interval, [this] { return stopping_; });
+    }
+}
@@ -0,0 +1,146 @@
+#include "url_matcher.hpp"
+#include <cctype>
+#include <cstring>
+
+UrlMatcher::UrlMatcher(const std::vector<std::string>& rules) : class_count_(1) {
+    // Class 0 is every byte that appears in no rule; letters share a class with their other case
+    memset(byte_class_, 0, sizeof(byte_class_));
+    std::vector<std::string> keys;
+    for (const auto& text : rules) {
+        Rule rule{text, 0, false, false};
+        std::string key = text;
+        if (!key.empty() && key.front() == '|') {
+            rule.anchored_start = true;
+            key.erase(0, 1);
+        }
+        if (!key.empty() && key.back() == '|') {
+            rule.anchored_end = true;
+            key.pop_back();
+        }
+        if (key.empty()) {
+            continue;
+        }
+        for (char& c : key) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            unsigned char byte = static_cast<unsigned char>(c);
+            if (byte_class_[byte] == 0) {
+                byte_class_[byte] = static_cast<uint8_t>(class_count_);
+                byte_class_[std::toupper(byte)] = static_cast<uint8_t>(class_count_);
+                class_count_++;
+            }
+        }
+        rule.length = key.size();
+        rules_.push_back(rule);
+        keys.push_back(key);
+    }
+
+    // Trie of all rules; -1 marks a missing edge until the failure pass fills it
+    transitions_.assign(class_count_, -1);
+    accept_.assign(1, -1);
+    std::vector<std::vector<int32_t>> anchored(1);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        int32_t state = 0;
+        for (unsigned char byte : keys[i]) {
+            int32_t& next = transitions_[state * class_count_ + byte_class_[byte]];
+            if (next < 0) {
+                next = static_cast<int32_t>(accept_.size());
+                transitions_.resize(transitions_.size() + class_count_, -1);
+                accept_.push_back(-1);
+                anchored.emplace_back();
+            }
+            state = transitions_[state * class_count_ + byte_class_[byte]];
+        }
+        if (rules_[i].anchored_start || rules_[i].anchored_end) {
+            anchored[state].push_back(static_cast<int32_t>(i));
+        } else if (accept_[state] < 0) {
+            accept_[state] = static_cast<int32_t>(i);
+        }
+    }
+
+    // Breadth-first failure links, folded straight into a full DFA: each
+    // state inherits the missing edges and the outputs of its failure state
+    std::vector<int32_t> failure(accept_.size(), 0);
+    std::vector<int32_t> queue;
+    queue.reserve(accept_.size());
+    for (size_t c = 0; c < class_count_; ++c) {
+        int32_t& next = transitions_[c];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int32_t state = queue[head];
+        int32_t fallback = failure[state];
+        if (accept_[state] < 0) {
+            accept_[state] = accept_[fallback];
+        }
+        anchored[state].insert(anchored[state].end(), anchored[fallback].begin(), anchored[fallback].end());
+
+        for (size_t c = 0; c < class_count_; ++c) {
+            int32_t& next = transitions_[state * class_count_ + c];
+            int32_t inherited = transitions_[fallback * class_count_ + c];
+            if (next < 0) {
+                next = inherited;
+            } else {
+                failure[next] = inherited;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    anchored_begin_.reserve(anchored.size() + 1);
+    for (const auto& ids : anchored) {
+        anchored_begin_.push_back(static_cast<uint32_t>(anchored_rules_.size()));
+        anchored_rules_.insert(anchored_rules_.end(), ids.begin(), ids.end());
+    }
+    anchored_begin_.push_back(static_cast<uint32_t>(anchored_rules_.size()));
+
+    for (int byte = 0; byte < 256; ++byte) {
+        starts_rule_[byte] = transitions_[byte_class_[byte]] != 0;
+    }
+}
+
+int UrlMatcher::find_concatenated(std::initializer_list<std::string_view> pieces) const {
+    if (rules_.empty()) {
+        return -1;
+    }
+
+    size_t size = 0;
+    for (std::string_view piece : pieces) {
+        size += piece.size();
+    }
+
+    // The state carries across pieces; positions are counted in the whole URL
+    int32_t state = 0;
+    size_t offset = 0;
+    for (std::string_view piece : pieces) {
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(piece.data());
+        size_t piece_size = piece.size();
+        for (size_t j = 0; j < piece_size; ++j) {
+            if (state == 0) {
+                while (j < piece_size && !starts_rule_[data[j]]) {
+                    ++j;
+                }
+                if (j == piece_size) {
+                    break;
+                }
+            }
+
+            state = transitions_[state * class_count_ + byte_class_[data[j]]];
+            if (accept_[state] >= 0) {
+                return accept_[state];
+            }
+            size_t end = offset + j + 1;
+            for (uint32_t k = anchored_begin_[state]; k < anchored_begin_[state + 1]; ++k) {
+                const Rule& rule = rules_[anchored_rules_[k]];
+                if ((!rule.anchored_start || end == rule.length) && (!rule.anchored_end || end == size)) {
+                    return anchored_rules_[k];
+                }
+            }
+        }
+        offset += piece_size;
+    }
+    return -1;
+}
@@ -1,12 +1,69 @@
 #include "web_ui.hpp"
 #include "logger.hpp"
+#include "buffer_pool.hpp"
+#include "proxy_server.hpp"
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+namespace {
+
+std::string json_escape(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size() + 2);
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char code[7];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += static_cast<char>(c);
+                }
+        }
+    }
+    return escaped;
+}
+
+// Unlimited buckets have no balance to show
+std::string json_tokens(double tokens) {
+    if (std::isinf(tokens)) {
+        return "null";
+    }
+    std::ostringstream out;
+    out << tokens;
+    return out.str();
+}
+
+std::vector<std::string> param_values(const httplib::Request& req, const std::string& name) {
+    std::vector<std::string> values;
+    size_t count = req.get_param_value_count(name);
+    values.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        values.push_back(req.get_param_value(name, i));
+    }
+    return values;
+}
+
+} // namespace
 
 WebUI::WebUI(uint16_t port, FilterManager& filter_manager)
     : port_(port), filter_manager_(filter_manager) {}
 
 void WebUI::start() {
+    started_ = true;
     server_.Get("/", [this](const httplib::Request&, httplib::Response& res) {
         res.set_content(generate_dashboard(), "text/html");
     });
@@ -23,6 +80,68 @@ void WebUI::start() {
         res.set_content("{\"success\":true}", "application/json");
     });
 
+    server_.Get("/api/blacklist", [this](const httplib::Request& req, httplib::Response& res) {
+        size_t limit = DEFAULT_PAGE_SIZE;
+        if (req.has_param("limit")) {
+            limit = std::min<size_t>(std::strtoul(req.get_param_value("limit").c_str(), nullptr, 10), MAX_PAGE_SIZE);
+        }
+        FilterManager::BlacklistPage page = filter_manager_.get_blacklist_page(
+            req.get_param_value("prefix"), req.get_param_value("after"), limit);
+
+        std::stringstream ss;
+        ss << "{\"total\":" << page.total << ",\"total_capped\":" << (page.total_capped ? "true" : "false")
+           << ",\"entries\":[";
+        for (size_t i = 0; i < page.entries.size(); ++i) {
+            ss << (i ? "," : "") << "\"" << json_escape(page.entries[i]) << "\"";
+        }
+        ss << "],\"next\":";
+        if (page.has_more && !page.entries.empty()) {
+            ss << "\"" << json_escape(page.entries.back()) << "\"";
+        } else {
+            ss << "null";
+        }
+        ss << "}";
+        res.set_content(ss.str(), "application/json");
+    });
+
+    server_.Post("/api/blacklist/batch", [this](const httplib::Request& req, httplib::Response& res) {
+        FilterManager::BatchResult result =
+            filter_manager_.apply_blacklist_batch(param_values(req, "add"), param_values(req, "remove"));
+        std::stringstream ss;
+        ss << "{\"success\":true,\"added\":" << result.added << ",\"removed\":" << result.removed
+           << ",\"total\":" << result.total << "}";
+        res.set_content(ss.str(), "application/json");
+    });
+
+    server_.Get("/api/url_rules", [this](const httplib::Request&, httplib::Response& res) {
+        std::vector<std::string> rules = filter_manager_.get_url_rules();
+        std::stringstream ss;
+        ss << "{\"rules\":[";
+        for (size_t i = 0; i < rules.size(); ++i) {
+            ss << (i ? "," : "") << "\"" << json_escape(rules[i]) << "\"";
+        }
+        ss << "]}";
+        res.set_content(ss.str(), "application/json");
+    });
+
+    server_.Post("/api/url_rules", [this](const httplib::Request& req, httplib::Response& res) {
+        FilterManager::BatchResult result =
+            filter_manager_.apply_url_rule_batch(param_values(req, "add"), param_values(req, "remove"));
+        std::stringstream ss;
+        ss << "{\"success\":true,\"added\":" << result.added << ",\"removed\":" << result.removed
+           << ",\"total\":" << result.total << "}";
+        res.set_content(ss.str(), "application/json");
+    });
+
+    server_.Post("/reload_blacklist", [this](const httplib::Request&, httplib::Response& res) {
+        if (!filter_manager_.request_reload()) {
+            res.status = 409;
+            res.set_content("{\"success\":false,\"error\":\"no snapshot configured\"}", "application/json");
+            return;
+        }
+        res.set_content("{\"success\":true}", "application/json");
+    });
+
     server_.Get("/logs", [this](const httplib::Request&, httplib::Response& res) {
         std::ifstream log_file("logs/proxy.log");
         std::stringstream buffer;
@@ -30,7 +149,85 @@ void WebUI::start() {
         res.set_content(buffer.str(), "text/plain");
     });
 
-    server_.listen("0.0.0.0", port_);
+    server_.Get("/api/buffers", [](const httplib::Request&, httplib::Response& res) {
+        BufferPool::Stats stats = BufferPool::stats();
+        std::stringstream ss;
+        ss << "{\"buffers_in_use\":" << stats.buffers_in_use
+           << ",\"bytes_in_use\":" << stats.bytes_in_use
+           << ",\"buffers_cached\":" << stats.buffers_cached
+           << ",\"bytes_cached\":" << stats.bytes_cached << "}";
+        res.set_content(ss.str(), "application/json");
+    });
+
+    server_.Get("/api/rate_limits", [this](const httplib::Request&, httplib::Response& res) {
+        std::stringstream ss;
+        if (!rate_limiter_) {
+            ss << "{\"enabled\":false}";
+        } else {
+            const RateLimiter::Config& config = rate_limiter_->config();
+            ss << "{\"enabled\":true"
+               << ",\"requests_per_second\":" << config.requests_per_second
+               << ",\"request_burst\":" << config.request_burst
+               << ",\"max_connections\":" << config.max_connections
+               << ",\"bytes_per_second\":" << config.bytes_per_second
+               << ",\"byte_burst\":" << config.byte_burst
+               << ",\"clients\":[";
+            bool first = true;
+            for (const auto& client : rate_limiter_->snapshot()) {
+                ss << (first ? "" : ",")
+                   << "{\"address\":\"" << client.address << "\""
+                   << ",\"connections\":" << client.connections
+                   << ",\"request_tokens\":" << json_tokens(client.request_tokens)
+                   << ",\"byte_tokens\":" << json_tokens(client.byte_tokens) << "}";
+                first = false;
+            }
+            ss << "]}";
+        }
+        res.set_content(ss.str(), "application/json");
+    });
+
+    server_.Get("/api/filter_stats", [this](const httplib::Request&, httplib::Response& res) {
+        // Counters exist only in builds with PROXY_FILTER_STATS
+        std::vector<FilterStageStats> stages;
+        if (proxy_server_) {
+            stages = proxy_server_->filter_stats();
+        }
+        std::stringstream ss;
+        if (stages.empty()) {
+            ss << "{\"enabled\":false}";
+        } else {
+            ss << "{\"enabled\":true,\"stages\":[";
+            bool first = true;
+            for (const FilterStageStats& stage : stages) {
+                ss << (first ? "" : ",")
+                   << "{\"name\":\"" << stage.name << "\""
+                   << ",\"calls\":" << stage.calls
+                   << ",\"denials\":" << stage.denials
+                   << ",\"modifications\":" << stage.modifications
+                   << ",\"nanoseconds\":" << stage.nanoseconds << "}";
+                first = false;
+            }
+            ss << "]}";
+        }
+        res.set_content(ss.str(), "application/json");
+    });
+
+    // During an upgrade the previous process may still hold the port briefly
+    for (int attempt = 0; !stopping_ && !server_.listen("0.0.0.0", port_) && attempt < LISTEN_RETRIES; ++attempt) {
+        Logger::get_instance().warning("Web UI port " + std::to_string(port_) + " busy, retrying");
+        std::this_thread::sleep_for(std::chrono::milliseconds(LISTEN_RETRY_MS));
+    }
+    finished_ = true;
+}
+
+void WebUI::stop() {
+    stopping_ = true;
+    // httplib ignores stop() until listen() is running, so repeat it until
+    // start() has returned
+    while (started_ && !finished_) {
+        server_.stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(STOP_RETRY_MS));
+    }
 }
 
 std::string WebUI::generate_dashboard() {
@@ -60,13 +257,29 @@ std::string WebUI::generate_dashboard() {
                 <input type="text" name="entry" placeholder="Add to blacklist..." required>
                 <button type="submit">Add</button>
             </form>
-            <ul id="blacklistEntries">)DELIM";
+            <form id="searchBlacklistForm">
+                <input type="text" name="prefix" placeholder="Search by prefix...">
+                <button type="submit">Search</button>
+            </form>
+            <p id="blacklistCount"></p>
+            <ul id="blacklistEntries"></ul>
+            <button id="loadMoreButton" onclick="loadBlacklistPage()">Load more</button>
+        </div>
 
-    for (const auto& entry : filter_manager_.get_blacklist()) {
-        ss << "<li class=\"blacklist-entry\">" << entry << " <button onclick=\"removeBlacklistEntry('" << entry << "')\">Remove</button></li>";
-    }
+        <div class="card">
+            <h2>URL Rules</h2>
+            <p>Block plain-HTTP requests whose URL contains a pattern. A leading or trailing <code>|</code> anchors it to the start or end.</p>
+            <form id="addUrlRuleForm">
+                <input type="text" name="rule" placeholder="/ads/ or tracker.js|" required>
+                <button type="submit">Add</button>
+            </form>
+            <ul id="urlRules"></ul>
+        </div>
 
-    ss << R"DELIM(</ul>
+        <div class="card">
+            <h2>Rate Limits</h2>
+            <div id="rateLimitConfig">Loading...</div>
+            <table id="rateLimitClients"></table>
         </div>
 
         <div class="card">
@@ -77,18 +290,93 @@ std::string WebUI::generate_dashboard() {
     </div>
 
     <script>
-        function removeBlacklistEntry(entry) {
-            fetch("/remove_blacklist", {
-                method: "POST",
-                headers: { "Content-Type": "application/x-www-form-urlencoded" },
-                body: "entry=" + encodeURIComponent(entry)
-            })
-            .then(response => response.json())
-            .then(data => {
-                if (data.success) {
-                    location.reload();
-                }
-            });
+        let blacklistPrefix = "";
+        let blacklistCursor = null;
+
+        function renderBlacklistEntry(entry) {
+            const item = document.createElement("li");
+            item.className = "blacklist-entry";
+            item.appendChild(document.createTextNode(entry + " "));
+            const button = document.createElement("button");
+            button.textContent = "Remove";
+            button.onclick = () => removeBlacklistEntry(entry, item);
+            item.appendChild(button);
+            document.getElementById("blacklistEntries").appendChild(item);
+        }
+
+        function loadBlacklistPage() {
+            const params = new URLSearchParams({ prefix: blacklistPrefix, limit: 100 });
+            if (blacklistCursor !== null) {
+                params.set("after", blacklistCursor);
+            }
+            fetch("/api/blacklist?" + params)
+                .then(response => response.json())
+                .then(page => {
+                    page.entries.forEach(renderBlacklistEntry);
+                    blacklistCursor = page.next;
+                    showBlacklistCount(page);
+                    document.getElementById("loadMoreButton").style.display = page.next === null ? "none" : "";
+                });
+        }
+
+        function showBlacklistCount(page) {
+            document.getElementById("blacklistCount").textContent =
+                page.total + (page.total_capped ? "+" : "") + " entries";
+        }
+
+        // Counts what the current search matches, like a page load does
+        function refreshBlacklistCount() {
+            const params = new URLSearchParams({ prefix: blacklistPrefix, limit: 0 });
+            fetch("/api/blacklist?" + params)
+                .then(response => response.json())
+                .then(showBlacklistCount);
+        }
+
+        function resetBlacklist(prefix) {
+            blacklistPrefix = prefix;
+            blacklistCursor = null;
+            document.getElementById("blacklistEntries").textContent = "";
+            loadBlacklistPage();
+        }
+
+        function updateBlacklist(action, entry) {
+            const body = new URLSearchParams();
+            body.append(action, entry);
+            return fetch("/api/blacklist/batch", { method: "POST", body: body })
+                .then(response => response.json())
+                .then(result => {
+                    refreshBlacklistCount();
+                    return result;
+                });
+        }
+
+        function removeBlacklistEntry(entry, item) {
+            updateBlacklist("remove", entry).then(() => item.remove());
+        }
+
+        function updateUrlRules(action, rule) {
+            const body = new URLSearchParams();
+            body.append(action, rule);
+            return fetch("/api/url_rules", { method: "POST", body: body }).then(refreshUrlRules);
+        }
+
+        function refreshUrlRules() {
+            fetch("/api/url_rules")
+                .then(response => response.json())
+                .then(result => {
+                    const list = document.getElementById("urlRules");
+                    list.textContent = "";
+                    result.rules.forEach(rule => {
+                        const item = document.createElement("li");
+                        item.className = "blacklist-entry";
+                        item.appendChild(document.createTextNode(rule + " "));
+                        const button = document.createElement("button");
+                        button.textContent = "Remove";
+                        button.onclick = () => updateUrlRules("remove", rule);
+                        item.appendChild(button);
+                        list.appendChild(item);
+                    });
+                });
         }
 
         function refreshLogs() {
@@ -99,26 +387,61 @@ std::string WebUI::generate_dashboard() {
                 });
         }
 
+        function refreshRateLimits() {
+            fetch("/api/rate_limits")
+                .then(response => response.json())
+                .then(limits => {
+                    const config = document.getElementById("rateLimitConfig");
+                    const table = document.getElementById("rateLimitClients");
+                    table.textContent = "";
+                    if (!limits.enabled) {
+                        config.textContent = "Rate limiting disabled";
+                        return;
+                    }
+                    config.textContent = "Requests/s: " + limits.requests_per_second +
+                        " (burst " + limits.request_burst + "), connections: " + limits.max_connections +
+                        ", bytes/s: " + limits.bytes_per_second + " (burst " + limits.byte_burst + ")";
+                    const header = table.insertRow();
+                    ["Client", "Connections", "Request tokens", "Byte tokens"].forEach(title => {
+                        header.insertCell().textContent = title;
+                    });
+                    limits.clients.forEach(client => {
+                        const row = table.insertRow();
+                        row.insertCell().textContent = client.address;
+                        row.insertCell().textContent = client.connections;
+                        row.insertCell().textContent = client.request_tokens === null ? "unlimited" : client.request_tokens.toFixed(1);
+                        row.insertCell().textContent = client.byte_tokens === null ? "unlimited" : client.byte_tokens.toFixed(0);
+                    });
+                });
+        }
+
         document.getElementById("addBlacklistForm").onsubmit = function(e) {
             e.preventDefault();
             const entry = e.target.entry.value;
-            fetch("/add_blacklist", {
-                method: "POST",
-                headers: { "Content-Type": "application/x-www-form-urlencoded" },
-                body: "entry=" + encodeURIComponent(entry)
-            })
-            .then(response => response.json())
-            .then(data => {
-                if (data.success) {
-                    location.reload();
-                }
+            updateBlacklist("add", entry).then(() => {
+                e.target.reset();
+                resetBlacklist(blacklistPrefix);
             });
         };
 
+        document.getElementById("addUrlRuleForm").onsubmit = function(e) {
+            e.preventDefault();
+            updateUrlRules("add", e.target.rule.value).then(() => e.target.reset());
+        };
+
+        document.getElementById("searchBlacklistForm").onsubmit = function(e) {
+            e.preventDefault();
+            resetBlacklist(e.target.prefix.value);
+        };
+
         // Load logs on page load
+        loadBlacklistPage();
+        refreshUrlRules();
         refreshLogs();
+        refreshRateLimits();
         // Refresh logs every 5 seconds
         setInterval(refreshLogs, 5000);
+        setInterval(refreshRateLimits, 5000);
     </script>
 </body>
 </html>)DELIM";
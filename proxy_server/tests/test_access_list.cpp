@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "access_list.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+TEST(AccessListTest, EmptyListAllowsEveryone) {
+    AccessList list;
+    EXPECT_TRUE(list.empty());
+    EXPECT_TRUE(list.allows("192.0.2.1"));
+    EXPECT_TRUE(list.allows("2001:db8::1"));
+}
+
+TEST(AccessListTest, DenyRulesOnly) {
+    AccessList list;
+    ASSERT_TRUE(list.add("192.0.2.0/24", AccessList::Action::DENY));
+    EXPECT_FALSE(list.allows("192.0.2.77"));
+    EXPECT_TRUE(list.allows("192.0.3.1"));
+}
+
+TEST(AccessListTest, AllowRulesDenyEverythingElse) {
+    AccessList list;
+    ASSERT_TRUE(list.add("10.0.0.0/8", AccessList::Action::ALLOW));
+    EXPECT_TRUE(list.allows("10.20.30.40"));
+    EXPECT_FALSE(list.allows("11.0.0.1"));
+    EXPECT_FALSE(list.allows("2001:db8::1"));
+}
+
+TEST(AccessListTest, LongestPrefixWins) {
+    AccessList list;
+    ASSERT_TRUE(list.add("10.0.0.0/8", AccessList::Action::ALLOW));
+    ASSERT_TRUE(list.add("10.1.0.0/16", AccessList::Action::DENY));
+    ASSERT_TRUE(list.add("10.1.2.3", AccessList::Action::ALLOW));
+    EXPECT_TRUE(list.allows("10.2.0.1"));
+    EXPECT_FALSE(list.allows("10.1.9.9"));
+    EXPECT_TRUE(list.allows("10.1.2.3"));
+    EXPECT_EQ(list.size(), 3u);
+
+    // Re-adding a prefix replaces its action
+    ASSERT_TRUE(list.add("10.1.0.0/16", AccessList::Action::ALLOW));
+    EXPECT_TRUE(list.allows("10.1.9.9"));
+    EXPECT_EQ(list.size(), 3u);
+}
+
+TEST(AccessListTest, HandlesIpv6AndMappedIpv4) {
+    AccessList list;
+    ASSERT_TRUE(list.add("2001:db8::/32", AccessList::Action::DENY));
+    ASSERT_TRUE(list.add("198.51.100.0/24", AccessList::Action::DENY));
+    EXPECT_FALSE(list.allows("2001:db8:1::5"));
+    EXPECT_TRUE(list.allows("2001:db9::5"));
+    EXPECT_FALSE(list.allows("::ffff:198.51.100.9"));
+
+    struct sockaddr_storage storage = {};
+    struct sockaddr_in* v4 = reinterpret_cast<struct sockaddr_in*>(&storage);
+    v4->sin_family = AF_INET;
+    inet_pton(AF_INET, "198.51.100.9", &v4->sin_addr);
+    EXPECT_FALSE(list.allows(storage));
+
+    storage = {};
+    struct sockaddr_in6* v6 = reinterpret_cast<struct sockaddr_in6*>(&storage);
+    v6->sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "::ffff:198.51.100.9", &v6->sin6_addr);
+    EXPECT_FALSE(list.allows(storage));
+}
+
+TEST(AccessListTest, RejectsInvalidRules) {
+    AccessList list;
+    EXPECT_FALSE(list.add("300.0.0.0/8", AccessList::Action::DENY));
+    EXPECT_FALSE(list.add("10.0.0.0/33", AccessList::Action::DENY));
+    EXPECT_FALSE(list.add("10.0.0.0/", AccessList::Action::DENY));
+    EXPECT_FALSE(list.add("2001:db8::/129", AccessList::Action::DENY));
+    EXPECT_TRUE(list.empty());
+}
+
+TEST(AccessListTest, LoadsFile) {
+    std::string path = (std::filesystem::temp_directory_path() / "test_access_list.txt").string();
+    {
+        std::ofstream file(path);
+        file << "# office networks\n"
+             << "allow 10.0.0.0/8\n"
+             << "\n"
+             << "deny 10.66.0.0/16   # lab\n";
+    }
+    AccessList list;
+    ASSERT_TRUE(list.load_file(path));
+    EXPECT_EQ(list.size(), 2u);
+    EXPECT_TRUE(list.allows("10.1.1.1"));
+    EXPECT_FALSE(list.allows("10.66.1.1"));
+
+    {
+        std::ofstream file(path);
+        file << "permit 10.0.0.0/8\n";
+    }
+    AccessList invalid;
+    EXPECT_FALSE(invalid.load_file(path));
+    std::filesystem::remove(path);
+}
+
+TEST(AccessListTest, AgreesWithLinearScanOnManyPrefixes) {
+    struct Rule {
+        uint32_t network;
+        int length;
+        bool allow;
+    };
+    std::mt19937 random(42);
+    std::vector<Rule> rules;
+    AccessList list;
+    for (int i = 0; i < 20000; ++i) {
+        int length = 8 + random() % 25;
+        uint32_t network = static_cast<uint32_t>(random()) & (~0u << (32 - length));
+        // Cluster some rules so prefixes nest
+        if (i % 4 == 0) {
+            network = (10u << 24) | (network >> 8);
+            network &= ~0u << (32 - length);
+        }
+        bool allow = random() % 2;
+        rules.push_back({network, length, allow});
+        struct in_addr addr = {htonl(network)};
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr, text, sizeof(text));
+        ASSERT_TRUE(list.add(std::string(text) + "/" + std::to_string(length),
+                             allow ? AccessList::Action::ALLOW : AccessList::Action::DENY));
+    }
+    list.compact();
+
+    for (int i = 0; i < 2000; ++i) {
+        uint32_t address = static_cast<uint32_t>(random());
+        if (i % 2 == 0) {
+            address = (10u << 24) | (address >> 8);
+        }
+        // Later rules for the same prefix replace earlier ones
+        int best_length = -1;
+        bool expected = false;
+        for (const Rule& rule : rules) {
+            uint32_t mask = ~0u << (32 - rule.length);
+            if ((address & mask) == rule.network && rule.length >= best_length) {
+                best_length = rule.length;
+                expected = rule.allow;
+            }
+        }
+        struct in_addr addr = {htonl(address)};
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr, text, sizeof(text));
+        ASSERT_EQ(list.allows(text), expected) << text;
+    }
+}
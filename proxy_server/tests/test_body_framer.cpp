@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "body_framer.hpp"
+#include <string>
+
+namespace {
+
+// Feeds `body` in pieces of `step` bytes and returns how many were counted
+size_t consume_in_steps(BodyFramer& framer, const std::string& body, size_t step) {
+    size_t used = 0;
+    for (size_t offset = 0; offset < body.size(); offset += step) {
+        size_t length = std::min(step, body.size() - offset);
+        used += framer.consume(body.data() + offset, length);
+    }
+    return used;
+}
+
+} // namespace
+
+TEST(BodyFramerTest, RequestWithoutBody) {
+    BodyFramer framer;
+    ASSERT_TRUE(framer.init("GET / HTTP/1.1\r\nHost: example.com\r\n\r\n"));
+    EXPECT_TRUE(framer.done());
+    EXPECT_EQ(framer.consume("GET /next", 9), 0u);
+}
+
+TEST(BodyFramerTest, ContentLength) {
+    BodyFramer framer;
+    ASSERT_TRUE(framer.init("POST / HTTP/1.1\r\ncontent-length: 10\r\n\r\n"));
+    EXPECT_FALSE(framer.done());
+    EXPECT_EQ(framer.consume("01234", 5), 5u);
+    EXPECT_FALSE(framer.done());
+    // Bytes past the body are not counted
+    EXPECT_EQ(framer.consume("56789GET", 8), 5u);
+    EXPECT_TRUE(framer.done());
+}
+
+TEST(BodyFramerTest, ChunkedAcrossArbitrarySplits) {
+    std::string body = "4\r\nWiki\r\n5;name=value\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n0\r\nX-Trailer: yes\r\n\r\n";
+    for (size_t step = 1; step <= body.size(); ++step) {
+        BodyFramer framer;
+        ASSERT_TRUE(framer.init("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+        EXPECT_TRUE(framer.chunked());
+        EXPECT_EQ(consume_in_steps(framer, body + "extra", step), body.size()) << "step " << step;
+        EXPECT_TRUE(framer.done());
+    }
+}
+
+TEST(BodyFramerTest, EmptyChunkedBody) {
+    BodyFramer framer;
+    ASSERT_TRUE(framer.init("POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"));
+    EXPECT_EQ(framer.consume("0\r\n\r\n", 5), 5u);
+    EXPECT_TRUE(framer.done());
+}
+
+TEST(BodyFramerTest, RejectsMalformedChunks) {
+    BodyFramer framer;
+    ASSERT_TRUE(framer.init("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+    framer.consume("zz\r\n", 4);
+    EXPECT_TRUE(framer.failed());
+
+    ASSERT_TRUE(framer.init("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+    framer.consume("3\r\nabcX", 7);
+    EXPECT_TRUE(framer.failed());
+
+    ASSERT_TRUE(framer.init("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+    framer.consume("ffffffffffffffff\r\n", 18);
+    EXPECT_TRUE(framer.failed());
+}
+
+TEST(BodyFramerTest, RejectsAmbiguousFraming) {
+    BodyFramer framer;
+    EXPECT_FALSE(framer.init("POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n"));
+    EXPECT_FALSE(framer.init("POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\n"));
+    EXPECT_FALSE(framer.init("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n"));
+    EXPECT_FALSE(framer.init("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n"));
+    EXPECT_TRUE(framer.init("POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\n"));
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "buffer_pool.hpp"
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST(BufferPoolTest, AcquireRoundsUpToSizeClass) {
+    auto small = BufferPool::acquire(100);
+    EXPECT_EQ(small.capacity(), BufferPool::SIZE_CLASSES[0]);
+
+    auto medium = BufferPool::acquire(BufferPool::SIZE_CLASSES[0] + 1);
+    EXPECT_EQ(medium.capacity(), BufferPool::SIZE_CLASSES[1]);
+
+    auto huge = BufferPool::acquire(10 * 1024 * 1024);
+    EXPECT_EQ(huge.capacity(), BufferPool::SIZE_CLASSES[BufferPool::NUM_CLASSES - 1]);
+}
+
+TEST(BufferPoolTest, GrowKeepsContents) {
+    auto buffer = BufferPool::acquire(1);
+    std::memcpy(buffer.data(), "hello", 5);
+
+    ASSERT_TRUE(buffer.grow(5));
+    EXPECT_EQ(buffer.capacity(), BufferPool::SIZE_CLASSES[1]);
+    EXPECT_EQ(std::memcmp(buffer.data(), "hello", 5), 0);
+
+    while (buffer.grow(5)) {}
+    EXPECT_EQ(buffer.capacity(), BufferPool::SIZE_CLASSES[BufferPool::NUM_CLASSES - 1]);
+    EXPECT_EQ(std::memcmp(buffer.data(), "hello", 5), 0);
+}
+
+TEST(BufferPoolTest, ShrinkReturnsToSmallestClass) {
+    auto buffer = BufferPool::acquire(BufferPool::SIZE_CLASSES[2]);
+    buffer.shrink(BufferPool::SIZE_CLASSES[0] + 1);
+    EXPECT_EQ(buffer.capacity(), BufferPool::SIZE_CLASSES[2]);
+
+    buffer.shrink();
+    EXPECT_EQ(buffer.capacity(), BufferPool::SIZE_CLASSES[0]);
+}
+
+TEST(BufferPoolTest, StatsTrackInUseAndCached) {
+    BufferPool::Stats before = BufferPool::stats();
+    {
+        auto buffer = BufferPool::acquire(BufferPool::SIZE_CLASSES[1]);
+        BufferPool::Stats during = BufferPool::stats();
+        EXPECT_EQ(during.buffers_in_use, before.buffers_in_use + 1);
+        EXPECT_EQ(during.bytes_in_use, before.bytes_in_use + BufferPool::SIZE_CLASSES[1]);
+    }
+    BufferPool::Stats after = BufferPool::stats();
+    EXPECT_EQ(after.buffers_in_use, before.buffers_in_use);
+    EXPECT_EQ(after.bytes_in_use, before.bytes_in_use);
+    EXPECT_GE(after.buffers_cached, 1u);
+}
+
+TEST(BufferPoolTest, ReusesReleasedBuffer) {
+    char* first;
+    {
+        auto buffer = BufferPool::acquire(BufferPool::SIZE_CLASSES[3]);
+        first = buffer.data();
+    }
+    auto buffer = BufferPool::acquire(BufferPool::SIZE_CLASSES[3]);
+    EXPECT_EQ(buffer.data(), first);
+}
+
+TEST(BufferPoolTest, ExitingThreadHandsCacheToDepot) {
+    // Empty this thread's cache so the next acquire has to visit the depot
+    std::vector<BufferPool::Buffer> held;
+    for (size_t i = 0; i < BufferPool::MAX_THREAD_CACHED; ++i) {
+        held.push_back(BufferPool::acquire(BufferPool::SIZE_CLASSES[2]));
+    }
+
+    const char* released = nullptr;
+    std::thread([&released] {
+        auto buffer = BufferPool::acquire(BufferPool::SIZE_CLASSES[2]);
+        released = buffer.data();
+    }).join();
+
+    BufferPool::Stats before = BufferPool::stats();
+    auto buffer = BufferPool::acquire(BufferPool::SIZE_CLASSES[2]);
+    BufferPool::Stats after = BufferPool::stats();
+    EXPECT_EQ(buffer.data(), released);
+    EXPECT_EQ(after.buffers_cached + 1, before.buffers_cached);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "capture_replay.hpp"
+#include "proxy_server.hpp"
+#include <filesystem>
+#include <thread>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string capture_path(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TrafficCapture::Record make_record(uint64_t offset_ns, const std::string& head, uint64_t response_bytes) {
+    TrafficCapture::Record record;
+    record.offset_ns = offset_ns;
+    record.request_bytes = head.size();
+    record.response_bytes = response_bytes;
+    record.host = "www.example.com";
+    record.port = 80;
+    record.head = head;
+    return record;
+}
+
+} // namespace
+
+class CaptureReplayTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addr_len = sizeof(addr);
+        bind(listener, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listener, 64);
+        getsockname(listener, (struct sockaddr*)&addr, &addr_len);
+        proxy.host = "127.0.0.1";
+        proxy.port = std::to_string(ntohs(addr.sin_port));
+
+        server = std::make_unique<ProxyServer>(ntohs(addr.sin_port), filter_manager);
+        server->adopt_listener(listener);
+        server_thread = std::thread([this] { server->start(); });
+    }
+
+    void TearDown() override {
+        server->stop_accepting();
+        server_thread.join();
+        server.reset();
+    }
+
+    FilterManager filter_manager;
+    std::unique_ptr<ProxyServer> server;
+    std::thread server_thread;
+    CaptureReplay::Endpoint proxy;
+};
+
+TEST_F(CaptureReplayTest, ReplaysRecordedCaptureThroughProxy) {
+    std::string path = capture_path("test_capture_replay.bin");
+    std::string body(20000, 'b');
+    {
+        TrafficCapture capture(path, 1.0);
+        capture.record(make_record(3000000, "GET http://www.example.com/large HTTP/1.1\r\n"
+                                            "Host: www.example.com\r\n\r\n", 70000));
+        capture.record(make_record(1000000, "GET http://www.example.com/ HTTP/1.1\r\n"
+                                            "Host: www.example.com\r\n\r\n", 100));
+        capture.record(make_record(2000000, "POST http://www.example.com/form HTTP/1.1\r\n"
+                                            "Host: www.example.com\r\nContent-Length: 20000\r\n\r\n", 10));
+        capture.record(make_record(4000000, "CONNECT www.example.com:443 HTTP/1.1\r\n"
+                                            "Host: www.example.com:443\r\n\r\n", 5000));
+    }
+
+    std::vector<TrafficCapture::Record> records;
+    ASSERT_TRUE(TrafficCapture::read_all(path, records));
+    ASSERT_EQ(records.size(), 4u);
+    EXPECT_TRUE(CaptureReplay::is_connect(records.back()));
+
+    CaptureReplay::Report report = CaptureReplay::run(records, proxy, 10.0, 2);
+    EXPECT_EQ(report.requests, 3u);
+    EXPECT_EQ(report.errors, 0u);
+    ASSERT_EQ(report.latencies_ms.size(), 3u);
+    EXPECT_LE(report.latencies_ms.front(), report.latencies_ms.back());
+    // Each answer carries the captured response size plus its head
+    EXPECT_GT(report.bytes, 70000u + 100u + 10u);
+    EXPECT_LT(report.bytes, 70000u + 100u + 10u + 3 * 1024u);
+
+    std::filesystem::remove(path);
+}
+
+TEST(CaptureReplayErrorTest, CountsErrorsWhenProxyIsUnreachable) {
+    std::vector<TrafficCapture::Record> records = {
+        make_record(0, "GET http://www.example.com/ HTTP/1.1\r\nHost: www.example.com\r\n\r\n", 100)};
+    CaptureReplay::Endpoint closed;
+    ASSERT_TRUE(CaptureReplay::parse_endpoint("127.0.0.1:1", closed));
+
+    CaptureReplay::Report report = CaptureReplay::run(records, closed, 1.0, 1);
+    EXPECT_EQ(report.requests, 1u);
+    EXPECT_EQ(report.errors, 1u);
+    EXPECT_TRUE(report.latencies_ms.empty());
+}
+
+TEST_F(CaptureReplayTest, SendsBodiesWhateverTheFieldCase) {
+    std::vector<TrafficCapture::Record> records = {
+        make_record(0, "POST http://www.example.com/a HTTP/1.1\r\nhost: www.example.com\r\n"
+                       "content-length: 5\r\n\r\n", 10),
+        make_record(1000, "POST http://www.example.com/b HTTP/1.1\r\nHost: www.example.com\r\n"
+                          "CONTENT-LENGTH:7000\r\n\r\n", 10),
+        make_record(2000, "POST http://www.example.com/c HTTP/1.1\r\nHost: www.example.com\r\n"
+                          "transfer-encoding: chunked\r\n\r\n", 10)};
+    EXPECT_TRUE(CaptureReplay::is_replayable(records[0]));
+    EXPECT_TRUE(CaptureReplay::is_chunked(records[2]));
+    EXPECT_FALSE(CaptureReplay::is_replayable(records[2]));
+
+    CaptureReplay::Report report = CaptureReplay::run(records, proxy, 10.0, 2);
+    EXPECT_EQ(report.requests, 2u);
+    EXPECT_EQ(report.errors, 0u);
+    EXPECT_EQ(report.body_bytes, 7005u);
+}
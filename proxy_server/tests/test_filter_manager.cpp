@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "filter_manager.hpp"
+#include <filesystem>
 
 class FilterManagerTest : public ::testing::Test {
 protected:
@@ -77,4 +78,142 @@ TEST_F(FilterManagerTest, BlacklistMode) {
     
     filter_manager->set_blacklist_mode(true);
     EXPECT_TRUE(filter_manager->is_blacklist_mode());
-} 
\ No newline at end of file
+} 
+
+TEST_F(FilterManagerTest, BatchAddRemove) {
+    EXPECT_EQ(filter_manager->add_blacklist_entries({"a.com", "b.com", "a.com", ""}), 2);
+    EXPECT_EQ(filter_manager->blacklist_size(), 2);
+
+    EXPECT_EQ(filter_manager->remove_blacklist_entries({"a.com", "missing.com"}), 1);
+    EXPECT_EQ(filter_manager->blacklist_size(), 1);
+    EXPECT_EQ(filter_manager->get_blacklist().count("b.com"), 1);
+
+    FilterManager::BatchResult result = filter_manager->apply_blacklist_batch({"c.com", "d.com"}, {"b.com", "c.com"});
+    EXPECT_EQ(result.added, 2);
+    EXPECT_EQ(result.removed, 2);
+    EXPECT_EQ(result.total, 1);
+    EXPECT_EQ(filter_manager->get_blacklist().count("d.com"), 1);
+}
+
+TEST_F(FilterManagerTest, BlacklistPaging) {
+    std::vector<std::string> entries;
+    for (int i = 0; i < 25; ++i) {
+        entries.push_back("host" + std::to_string(100 + i) + ".com");
+    }
+    filter_manager->add_blacklist_entries(entries);
+
+    std::vector<std::string> seen;
+    std::string cursor;
+    while (true) {
+        auto page = filter_manager->get_blacklist_page("", cursor, 10);
+        EXPECT_EQ(page.total, 25);
+        seen.insert(seen.end(), page.entries.begin(), page.entries.end());
+        if (!page.has_more) {
+            break;
+        }
+        cursor = page.entries.back();
+    }
+    EXPECT_EQ(seen, entries);
+}
+
+TEST_F(FilterManagerTest, BlacklistPrefixSearch) {
+    filter_manager->add_blacklist_entries({"ads.example.com", "ads.test.org", "adserver.net", "tracker.io"});
+
+    auto page = filter_manager->get_blacklist_page("ads.", "", 10);
+    EXPECT_EQ(page.total, 2);
+    ASSERT_EQ(page.entries.size(), 2);
+    EXPECT_EQ(page.entries[0], "ads.example.com");
+    EXPECT_EQ(page.entries[1], "ads.test.org");
+    EXPECT_FALSE(page.has_more);
+
+    page = filter_manager->get_blacklist_page("ads", "", 1);
+    EXPECT_EQ(page.total, 3);
+    ASSERT_EQ(page.entries.size(), 1);
+    EXPECT_TRUE(page.has_more);
+
+    page = filter_manager->get_blacklist_page("ads", page.entries.back(), 10);
+    ASSERT_EQ(page.entries.size(), 2);
+    EXPECT_EQ(page.entries[1], "adserver.net");
+    EXPECT_FALSE(page.has_more);
+
+    EXPECT_TRUE(filter_manager->get_blacklist_page("zzz", "", 10).entries.empty());
+}
+
+TEST_F(FilterManagerTest, BlacklistPrefixCountIsCapped) {
+    std::vector<std::string> entries;
+    for (size_t i = 0; i < FilterManager::MAX_COUNTED_MATCHES + 5; ++i) {
+        entries.push_back("cdn" + std::to_string(10000 + i) + ".example");
+    }
+    entries.push_back("other.example");
+    filter_manager->add_blacklist_entries(entries);
+
+    auto page = filter_manager->get_blacklist_page("cdn", "", 10);
+    EXPECT_EQ(page.total, FilterManager::MAX_COUNTED_MATCHES);
+    EXPECT_TRUE(page.total_capped);
+    EXPECT_TRUE(page.has_more);
+
+    page = filter_manager->get_blacklist_page("cdn1000", "", 10);
+    EXPECT_EQ(page.total, 10u);
+    EXPECT_FALSE(page.total_capped);
+
+    // No prefix: the exact size is known without walking
+    page = filter_manager->get_blacklist_page("", "", 0);
+    EXPECT_EQ(page.total, entries.size());
+    EXPECT_FALSE(page.total_capped);
+    EXPECT_TRUE(page.entries.empty());
+}
+
+TEST_F(FilterManagerTest, UrlRules) {
+    filter_manager->set_blacklist_mode(true);
+    EXPECT_TRUE(filter_manager->add_url_rule("/ads/"));
+    EXPECT_TRUE(filter_manager->add_url_rule("tracker.js|"));
+    EXPECT_FALSE(filter_manager->add_url_rule("/ads/"));
+
+    EXPECT_EQ(filter_manager->match_url_rule("http://example.com/ads/banner.png"), "/ads/");
+    EXPECT_EQ(filter_manager->match_url_rule("http://cdn.example.com/js/tracker.js"), "tracker.js|");
+    EXPECT_EQ(filter_manager->match_url_rule("http://example.com/tracker.js.map"), "");
+
+    EXPECT_TRUE(filter_manager->remove_url_rule("/ads/"));
+    EXPECT_EQ(filter_manager->match_url_rule("http://example.com/ads/banner.png"), "");
+    EXPECT_EQ(filter_manager->get_url_rules(), std::vector<std::string>{"tracker.js|"});
+
+    filter_manager->set_blacklist_mode(false);
+    EXPECT_EQ(filter_manager->match_url_rule("http://cdn.example.com/js/tracker.js"), "");
+}
+
+TEST_F(FilterManagerTest, UrlRuleBatch) {
+    filter_manager->set_blacklist_mode(true);
+    auto result = filter_manager->apply_url_rule_batch({"/ads/", "tracker.js|", "/ads/", "|", ""}, {"missing"});
+    EXPECT_EQ(result.added, 2u);
+    EXPECT_EQ(result.removed, 0u);
+    EXPECT_EQ(result.total, 2u);
+
+    result = filter_manager->apply_url_rule_batch({"/beacon"}, {"/ads/", "tracker.js|"});
+    EXPECT_EQ(result.added, 1u);
+    EXPECT_EQ(result.removed, 2u);
+    EXPECT_EQ(filter_manager->get_url_rules(), std::vector<std::string>{"/beacon"});
+
+    std::string rule;
+    EXPECT_TRUE(filter_manager->match_url_rule({"http://", "example.com", "/beacon?id=1"}, rule));
+    EXPECT_EQ(rule, "/beacon");
+    EXPECT_FALSE(filter_manager->match_url_rule({"http://", "example.com", "/ads/x"}, rule));
+}
+
+TEST_F(FilterManagerTest, UrlRulesPersistWithSnapshot) {
+    std::string path = (std::filesystem::temp_directory_path() / "test_url_rules.snapshot").string();
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".rules");
+
+    filter_manager->enable_persistence(path);
+    filter_manager->set_blacklist_mode(true);
+    filter_manager->add_url_rule("/ads/");
+    ASSERT_TRUE(filter_manager->save_snapshot());
+
+    FilterManager restored;
+    restored.enable_persistence(path);
+    EXPECT_EQ(restored.get_url_rules(), std::vector<std::string>{"/ads/"});
+    EXPECT_EQ(restored.match_url_rule("http://example.com/ads/x"), "/ads/");
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".rules");
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "filter_snapshot.hpp"
+#include "filter_manager.hpp"
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <chrono>
+
+class FilterSnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        snapshot_path = (std::filesystem::temp_directory_path() / "test_filter_snapshot.bin").string();
+        std::filesystem::remove(snapshot_path);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(snapshot_path);
+    }
+
+    std::string snapshot_path;
+};
+
+TEST_F(FilterSnapshotTest, WriteAndRead) {
+    std::set<std::string> entries = {"example.com", "test.org", "a.b.c"};
+    ASSERT_TRUE(FilterSnapshot::write(snapshot_path, entries, true));
+
+    std::set<std::string> loaded;
+    bool mode = false;
+    ASSERT_TRUE(FilterSnapshot::read(snapshot_path, loaded, mode));
+    EXPECT_EQ(loaded, entries);
+    EXPECT_TRUE(mode);
+    EXPECT_FALSE(std::filesystem::exists(snapshot_path + ".tmp"));
+}
+
+TEST_F(FilterSnapshotTest, EmptySnapshot) {
+    ASSERT_TRUE(FilterSnapshot::write(snapshot_path, {}, false));
+
+    std::set<std::string> loaded = {"stale.com"};
+    bool mode = true;
+    ASSERT_TRUE(FilterSnapshot::read(snapshot_path, loaded, mode));
+    EXPECT_TRUE(loaded.empty());
+    EXPECT_FALSE(mode);
+}
+
+TEST_F(FilterSnapshotTest, RejectsMissingAndCorruptFiles) {
+    std::set<std::string> loaded = {"kept.com"};
+    bool mode = true;
+    EXPECT_FALSE(FilterSnapshot::read(snapshot_path, loaded, mode));
+
+    ASSERT_TRUE(FilterSnapshot::write(snapshot_path, {"example.com"}, true));
+    std::filesystem::resize_file(snapshot_path, std::filesystem::file_size(snapshot_path) - 1);
+    EXPECT_FALSE(FilterSnapshot::read(snapshot_path, loaded, mode));
+
+    std::ofstream(snapshot_path, std::ios::trunc) << "not a snapshot at all";
+    EXPECT_FALSE(FilterSnapshot::read(snapshot_path, loaded, mode));
+
+    EXPECT_EQ(loaded.count("kept.com"), 1);
+}
+
+TEST_F(FilterSnapshotTest, RejectsBlobSizeThatWrapsTheFileSize) {
+    // Header and offsets claim 40 bytes; the blob size wraps the sum to 32
+    FilterSnapshot::Header header = {};
+    header.magic = FilterSnapshot::MAGIC;
+    header.version = FilterSnapshot::VERSION;
+    header.entry_count = 3;
+    header.blob_size = ~0ull - 7;
+    {
+        std::ofstream file(snapshot_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write("\0\0\0\0\0\0\0\0", 32 - sizeof(header));
+    }
+    ASSERT_EQ(std::filesystem::file_size(snapshot_path), 32u);
+
+    std::set<std::string> loaded;
+    bool mode = false;
+    EXPECT_FALSE(FilterSnapshot::read(snapshot_path, loaded, mode));
+}
+
+TEST_F(FilterSnapshotTest, FilterManagerPersistsAcrossRestart) {
+    {
+        FilterManager manager;
+        ASSERT_TRUE(manager.enable_persistence(snapshot_path));
+        manager.add_blacklist_entry("example.com");
+        manager.add_blacklist_entry("test.org");
+        manager.remove_blacklist_entry("test.org");
+    }
+
+    FilterManager restarted;
+    ASSERT_TRUE(restarted.enable_persistence(snapshot_path));
+    auto blacklist = restarted.get_blacklist();
+    EXPECT_EQ(blacklist.size(), 1);
+    EXPECT_EQ(blacklist.count("example.com"), 1);
+}
+
+TEST_F(FilterSnapshotTest, ReloadSwapsInChangedFile) {
+    FilterManager manager;
+    ASSERT_TRUE(manager.enable_persistence(snapshot_path));
+    manager.set_blacklist_mode(true);
+    manager.add_blacklist_entry("old.com");
+    // The debounced write must land before the file is replaced under it
+    ASSERT_TRUE(manager.wait_for_persistence(std::chrono::seconds(5)));
+
+    ASSERT_TRUE(FilterSnapshot::write(snapshot_path, {"new.com"}, true));
+    ASSERT_TRUE(manager.request_reload());
+    ASSERT_TRUE(manager.wait_for_persistence(std::chrono::seconds(5)));
+
+    EXPECT_TRUE(manager.is_blocked("new.com"));
+    EXPECT_FALSE(manager.is_blocked("old.com"));
+}
+
+TEST_F(FilterSnapshotTest, ReloadNeedsPersistence) {
+    FilterManager manager;
+    EXPECT_FALSE(manager.request_reload());
+}
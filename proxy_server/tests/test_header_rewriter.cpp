@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include "header_rewriter.hpp"
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string flatten(const HeaderRewriter& rewriter) {
+    std::string out;
+    for (const struct iovec& slice : rewriter.slices()) {
+        out.append(static_cast<const char*>(slice.iov_base), slice.iov_len);
+    }
+    return out;
+}
+
+std::string rewrite(const std::string& request, bool keep_absolute_form = false) {
+    HeaderRewriter rewriter;
+    HeaderRewriter::Options options;
+    options.keep_absolute_form = keep_absolute_form;
+    options.client_address = "10.0.0.7";
+    EXPECT_TRUE(rewriter.rewrite(request, options));
+    EXPECT_EQ(rewriter.size(), flatten(rewriter).size());
+    return flatten(rewriter);
+}
+
+} // namespace
+
+TEST(HeaderRewriterTest, ConvertsAbsoluteFormAndAddsFields) {
+    std::string out = rewrite("GET http://example.com:8080/a/b?c=d HTTP/1.1\r\n"
+                              "Host: example.com:8080\r\n"
+                              "Accept: */*\r\n\r\n");
+    EXPECT_EQ(out, "GET /a/b?c=d HTTP/1.1\r\n"
+                   "Host: example.com:8080\r\n"
+                   "Accept: */*\r\n"
+                   "Connection: close\r\n"
+                   "Via: 1.1 cxx_proxy\r\n"
+                   "X-Forwarded-For: 10.0.0.7\r\n\r\n");
+}
+
+TEST(HeaderRewriterTest, AddsRootPathForBareAuthority) {
+    std::string out = rewrite("GET http://example.com HTTP/1.0\r\nHost: example.com\r\n\r\n");
+    EXPECT_EQ(out.substr(0, out.find("\r\n")), "GET / HTTP/1.0");
+    EXPECT_NE(out.find("Via: 1.0 cxx_proxy\r\n"), std::string::npos);
+}
+
+TEST(HeaderRewriterTest, KeepsAbsoluteFormForParentProxy) {
+    std::string out = rewrite("GET http://example.com/x HTTP/1.1\r\n"
+                              "Host: example.com\r\n"
+                              "Proxy-Authorization: Basic abc\r\n\r\n", true);
+    EXPECT_EQ(out.substr(0, out.find("\r\n")), "GET http://example.com/x HTTP/1.1");
+    EXPECT_NE(out.find("Proxy-Authorization: Basic abc\r\n"), std::string::npos);
+}
+
+TEST(HeaderRewriterTest, StripsHopByHopHeaders) {
+    std::string out = rewrite("GET / HTTP/1.1\r\n"
+                              "Host: example.com\r\n"
+                              "Proxy-Connection: keep-alive\r\n"
+                              "connection: keep-alive, X-Private\r\n"
+                              "Keep-Alive: timeout=5\r\n"
+                              "X-Private: secret\r\n"
+                              "Proxy-Authorization: Basic abc\r\n"
+                              "X-Folded: one\r\n"
+                              " two\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Accept: */*\r\n\r\n");
+    EXPECT_EQ(out, "GET / HTTP/1.1\r\n"
+                   "Host: example.com\r\n"
+                   "X-Folded: one\r\n"
+                   " two\r\n"
+                   "Accept: */*\r\n"
+                   "Connection: close\r\n"
+                   "Via: 1.1 cxx_proxy\r\n"
+                   "X-Forwarded-For: 10.0.0.7\r\n\r\n");
+}
+
+TEST(HeaderRewriterTest, ExtendsExistingViaAndForwardedFor) {
+    std::string out = rewrite("GET / HTTP/1.1\r\n"
+                              "Via: 1.1 edge\r\n"
+                              "X-Forwarded-For: 192.0.2.1\r\n"
+                              "Host: example.com\r\n\r\n");
+    EXPECT_EQ(out, "GET / HTTP/1.1\r\n"
+                   "Via: 1.1 edge, 1.1 cxx_proxy\r\n"
+                   "X-Forwarded-For: 192.0.2.1, 10.0.0.7\r\n"
+                   "Host: example.com\r\n"
+                   "Connection: close\r\n\r\n");
+}
+
+TEST(HeaderRewriterTest, ForwardsBodyBytesWithoutCopying) {
+    std::string request = "POST http://example.com/form HTTP/1.1\r\n"
+                          "Host: example.com\r\n"
+                          "Content-Length: 7\r\n\r\n"
+                          "abc=def";
+    HeaderRewriter rewriter;
+    ASSERT_TRUE(rewriter.rewrite(request, HeaderRewriter::Options()));
+
+    // The final slice is the blank line and body, straight from the request buffer
+    const struct iovec& last = rewriter.slices().back();
+    EXPECT_EQ(static_cast<const char*>(last.iov_base), request.data() + request.find("\r\n\r\n") + 2);
+    EXPECT_EQ(std::string(static_cast<const char*>(last.iov_base), last.iov_len), "\r\nabc=def");
+    EXPECT_EQ(flatten(rewriter).find("X-Forwarded-For"), std::string::npos);
+}
+
+TEST(HeaderRewriterTest, RejectsIncompleteOrMalformedHeads) {
+    HeaderRewriter rewriter;
+    EXPECT_FALSE(rewriter.rewrite("GET / HTTP/1.1\r\nHost: example.com\r\n", HeaderRewriter::Options()));
+    EXPECT_FALSE(rewriter.rewrite("GET /\r\n\r\n", HeaderRewriter::Options()));
+    EXPECT_FALSE(rewriter.rewrite("GET / HTTP/1.1\r\nno colon here\r\n\r\n", HeaderRewriter::Options()));
+}
+
+TEST(HeaderRewriterTest, RejectsConnectionNamingFramingFields) {
+    HeaderRewriter rewriter;
+    EXPECT_FALSE(rewriter.rewrite("POST http://example.com/ HTTP/1.1\r\n"
+                                  "Host: example.com\r\n"
+                                  "Content-Length: 5\r\n"
+                                  "Connection: Content-Length, Host\r\n\r\nhello", HeaderRewriter::Options()));
+    EXPECT_FALSE(rewriter.rewrite("POST / HTTP/1.1\r\n"
+                                  "Host: example.com\r\n"
+                                  "Transfer-Encoding: chunked\r\n"
+                                  "Connection: keep-alive, transfer-encoding\r\n\r\n", HeaderRewriter::Options()));
+}
+
+TEST(HeaderRewriterTest, FiltersCannotRemoveFramingFields) {
+    std::vector<std::string> removed = {"Content-Length", "Host", "Cookie"};
+    HeaderRewriter rewriter;
+    HeaderRewriter::Options options;
+    options.removed_fields = &removed;
+    ASSERT_TRUE(rewriter.rewrite("POST / HTTP/1.1\r\n"
+                                 "Host: example.com\r\n"
+                                 "Content-Length: 5\r\n"
+                                 "Cookie: a=b\r\n\r\nhello", options));
+    std::string out = flatten(rewriter);
+    EXPECT_NE(out.find("Host: example.com\r\n"), std::string::npos);
+    EXPECT_NE(out.find("Content-Length: 5\r\n"), std::string::npos);
+    EXPECT_EQ(out.find("Cookie"), std::string::npos);
+}
+
+TEST(HeaderRewriterTest, SendsAllSlices) {
+    std::string request = "GET http://example.com/ HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    HeaderRewriter rewriter;
+    ASSERT_TRUE(rewriter.rewrite(request, HeaderRewriter::Options()));
+
+    int pair[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+    ASSERT_TRUE(rewriter.send(pair[0]));
+    close(pair[0]);
+
+    std::string received;
+    char buffer[256];
+    ssize_t bytes;
+    while ((bytes = read(pair[1], buffer, sizeof(buffer))) > 0) {
+        received.append(buffer, bytes);
+    }
+    close(pair[1]);
+    EXPECT_EQ(received, flatten(rewriter));
+}
@@ -0,0 +1,301 @@
+#include <gtest/gtest.h>
+#include "proxy_server.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+int open_loopback_listener(int& port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    bind(listener, (struct sockaddr*)&addr, sizeof(addr));
+    listen(listener, 16);
+    getsockname(listener, (struct sockaddr*)&addr, &addr_len);
+    port = ntohs(addr.sin_port);
+    return listener;
+}
+
+int connect_loopback(int port) {
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(socket_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(socket_fd);
+        return -1;
+    }
+    return socket_fd;
+}
+
+bool send_all(int socket_fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t bytes = send(socket_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (bytes <= 0) {
+            return false;
+        }
+        sent += bytes;
+    }
+    return true;
+}
+
+// Reads until the peer closes
+std::string read_all(int socket_fd) {
+    std::string data;
+    char buffer[16384];
+    ssize_t bytes;
+    while ((bytes = recv(socket_fd, buffer, sizeof(buffer), 0)) > 0) {
+        data.append(buffer, bytes);
+    }
+    return data;
+}
+
+std::string read_head(int socket_fd) {
+    std::string head;
+    char c;
+    while (head.find("\r\n\r\n") == std::string::npos && recv(socket_fd, &c, 1, 0) == 1) {
+        head += c;
+    }
+    return head;
+}
+
+std::string get_request(int origin_port) {
+    std::string authority = "127.0.0.1:" + std::to_string(origin_port);
+    return "GET http://" + authority + "/ HTTP/1.1\r\nHost: " + authority + "\r\n\r\n";
+}
+
+} // namespace
+
+class ProxyServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        int listener = open_loopback_listener(proxy_port);
+        origin = open_loopback_listener(origin_port);
+        server = std::make_unique<ProxyServer>(proxy_port, filter_manager);
+        server->adopt_listener(listener);
+        server->set_head_timeout(std::chrono::milliseconds(HEAD_TIMEOUT_MS));
+        server_thread = std::thread([this] { server->start(); });
+    }
+
+    void TearDown() override {
+        stop_accepting();
+        server.reset();
+        close(origin);
+    }
+
+    // start() returns once the accept loop has seen the flag
+    void stop_accepting() {
+        server->stop_accepting();
+        if (server_thread.joinable()) {
+            server_thread.join();
+        }
+    }
+
+    static constexpr int HEAD_TIMEOUT_MS = 500;
+
+    FilterManager filter_manager;
+    std::unique_ptr<ProxyServer> server;
+    std::thread server_thread;
+    int proxy_port = 0;
+    int origin = -1;
+    int origin_port = 0;
+};
+
+TEST_F(ProxyServerTest, DrainLetsInFlightRequestsFinish) {
+    std::promise<void> accepted;
+    std::atomic<bool> answered{false};
+    std::thread origin_thread([this, &accepted, &answered] {
+        int upstream = accept(origin, nullptr, nullptr);
+        accepted.set_value();
+        read_head(upstream);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        send_all(upstream, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+        answered = true;
+        close(upstream);
+    });
+
+    int client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(send_all(client, get_request(origin_port)));
+    accepted.get_future().wait();
+
+    stop_accepting();
+    auto started = std::chrono::steady_clock::now();
+    server->drain(std::chrono::seconds(5));
+    EXPECT_TRUE(answered);
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(4));
+
+    std::string response = read_all(client);
+    EXPECT_EQ(response.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << response;
+    EXPECT_EQ(response.substr(response.size() - 2), "ok");
+    close(client);
+    origin_thread.join();
+}
+
+TEST_F(ProxyServerTest, DrainDeadlineClosesStragglers) {
+    std::promise<void> accepted;
+    std::promise<void> finished;
+    std::thread origin_thread([this, &accepted, &finished] {
+        // Never answers
+        int upstream = accept(origin, nullptr, nullptr);
+        accepted.set_value();
+        finished.get_future().wait();
+        close(upstream);
+    });
+
+    int client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(send_all(client, get_request(origin_port)));
+    accepted.get_future().wait();
+
+    stop_accepting();
+    auto started = std::chrono::steady_clock::now();
+    server->drain(std::chrono::milliseconds(300));
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(300));
+    EXPECT_LT(elapsed, std::chrono::seconds(3));
+
+    EXPECT_EQ(read_all(client), "");
+    close(client);
+    finished.set_value();
+    origin_thread.join();
+}
+
+TEST_F(ProxyServerTest, MalformedHeadIsRejectedBeforeDialling) {
+    std::string authority = "127.0.0.1:" + std::to_string(origin_port);
+    int client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(send_all(client, "GET http://" + authority + "/ HTTP/1.1\r\nHost: " + authority +
+                                 "\r\nno colon here\r\n\r\n"));
+
+    EXPECT_EQ(read_all(client).rfind("HTTP/1.1 400 Bad Request\r\n", 0), 0u);
+    struct pollfd pending = {origin, POLLIN, 0};
+    EXPECT_EQ(poll(&pending, 1, 100), 0);
+    close(client);
+}
+
+TEST_F(ProxyServerTest, MalformedEarlyChunkIsRejectedBeforeDialling) {
+    std::string authority = "127.0.0.1:" + std::to_string(origin_port);
+    int client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(send_all(client, "POST http://" + authority + "/ HTTP/1.1\r\nHost: " + authority +
+                                 "\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n"));
+
+    EXPECT_EQ(read_all(client).rfind("HTTP/1.1 400 Bad Request\r\n", 0), 0u);
+    struct pollfd pending = {origin, POLLIN, 0};
+    EXPECT_EQ(poll(&pending, 1, 100), 0);
+    close(client);
+}
+
+TEST_F(ProxyServerTest, TrickledHeadTimesOut) {
+    int client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    std::atomic<bool> done{false};
+    // Every read is short, but the head never completes
+    std::thread trickle([client, &done] {
+        ASSERT_TRUE(send_all(client, "GET http://127.0.0.1/ HTTP/1.1\r\n"));
+        for (int i = 0; i < 50 && !done && send_all(client, "X: y\r\n"); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
+    auto started = std::chrono::steady_clock::now();
+    std::string response = read_all(client);
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    done = true;
+    trickle.join();
+
+    EXPECT_EQ(response.rfind("HTTP/1.1 408 Request Timeout\r\n", 0), 0u) << response;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(HEAD_TIMEOUT_MS - 50));
+    EXPECT_LT(elapsed, std::chrono::seconds(3));
+    close(client);
+}
+
+TEST_F(ProxyServerTest, StreamsBodiesLargerThanTheBuffer) {
+    constexpr size_t SIZE = 64 * ProxyServer::BUFFER_SIZE + 123;
+    std::string request_body(SIZE, 0);
+    std::string response_body(SIZE, 0);
+    for (size_t i = 0; i < SIZE; ++i) {
+        request_body[i] = static_cast<char>('a' + i % 26);
+        response_body[i] = static_cast<char>('A' + i % 23);
+    }
+
+    std::promise<std::string> received;
+    std::thread origin_thread([&] {
+        int upstream = accept(origin, nullptr, nullptr);
+        std::string head = read_head(upstream);
+        std::string body;
+        char chunk[16384];
+        ssize_t bytes;
+        while (body.size() < SIZE && (bytes = recv(upstream, chunk, sizeof(chunk), 0)) > 0) {
+            body.append(chunk, bytes);
+        }
+        received.set_value(body);
+        send_all(upstream, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(SIZE) + "\r\n\r\n" + response_body);
+        close(upstream);
+    });
+
+    std::string authority = "127.0.0.1:" + std::to_string(origin_port);
+    int client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(send_all(client, "POST http://" + authority + "/upload HTTP/1.1\r\nHost: " + authority +
+                                 "\r\nContent-Length: " + std::to_string(SIZE) + "\r\n\r\n" + request_body));
+
+    std::string response = read_all(client);
+    origin_thread.join();
+    EXPECT_TRUE(received.get_future().get() == request_body);
+    size_t body_start = response.find("\r\n\r\n");
+    ASSERT_NE(body_start, std::string::npos);
+    EXPECT_EQ(response.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+    EXPECT_TRUE(response.compare(body_start + 4, std::string::npos, response_body) == 0);
+    close(client);
+}
+
+TEST_F(ProxyServerTest, InvalidPortsAreRejected) {
+    // 65616 would wrap to 80 in a uint16_t
+    for (const std::string port : {"65616", "0", "80abc", "-1", ""}) {
+        for (bool tunnel : {true, false}) {
+            std::string authority = "127.0.0.1:" + port;
+            std::string request = tunnel
+                ? "CONNECT " + authority + " HTTP/1.1\r\nHost: " + authority + "\r\n\r\n"
+                : "GET http://" + authority + "/ HTTP/1.1\r\nHost: " + authority + "\r\n\r\n";
+            int client = connect_loopback(proxy_port);
+            ASSERT_GE(client, 0);
+            ASSERT_TRUE(send_all(client, request));
+            EXPECT_EQ(read_all(client).rfind("HTTP/1.1 400 Bad Request\r\n", 0), 0u) << request;
+            close(client);
+        }
+    }
+}
+
+TEST_F(ProxyServerTest, AbsoluteTargetDecidesTheHost) {
+    filter_manager.add_blacklist_entry("blocked.example");
+    std::string authority = "127.0.0.1:" + std::to_string(origin_port);
+
+    // A harmless Host must not smuggle a blocked target past the blacklist
+    int client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(send_all(client, "GET http://blocked.example/ HTTP/1.1\r\nHost: " + authority + "\r\n\r\n"));
+    EXPECT_EQ(read_all(client).rfind("HTTP/1.1 400 Bad Request\r\n", 0), 0u);
+    close(client);
+
+    client = connect_loopback(proxy_port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(send_all(client, "GET http://blocked.example/ HTTP/1.1\r\nX-Forwarded-Host: " + authority + "\r\n\r\n"));
+    EXPECT_EQ(read_all(client).rfind("HTTP/1.1 403 Forbidden\r\n", 0), 0u);
+    close(client);
+
+    struct pollfd pending = {origin, POLLIN, 0};
+    EXPECT_EQ(poll(&pending, 1, 100), 0);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "rate_limiter.hpp"
+#include <cmath>
+#include <thread>
+#include <vector>
+
+TEST(TokenBucketTest, UnlimitedBucketNeverRefuses) {
+    TokenBucket bucket;
+    bucket.configure(0, 0);
+    int64_t now = RateLimiter::now_ns();
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(bucket.try_consume(1000, now));
+    }
+    EXPECT_EQ(bucket.consume(1e9, now).count(), 0);
+    EXPECT_TRUE(std::isinf(bucket.available(now)));
+}
+
+TEST(TokenBucketTest, ZeroBurstHoldsOneSecondOfRate) {
+    TokenBucket bucket;
+    bucket.configure(10, 0);
+    int64_t now = RateLimiter::now_ns();
+    EXPECT_DOUBLE_EQ(bucket.available(now), 10);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(bucket.try_consume(1, now));
+    }
+    EXPECT_FALSE(bucket.try_consume(1, now));
+}
+
+TEST(TokenBucketTest, BurstThenRefill) {
+    TokenBucket bucket;
+    bucket.configure(10, 5);
+    int64_t now = RateLimiter::now_ns();
+
+    // The burst caps the bucket even below one second of rate
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(bucket.try_consume(1, now));
+    }
+    EXPECT_FALSE(bucket.try_consume(1, now));
+
+    // 100 ms at 10/s refills one token
+    EXPECT_TRUE(bucket.try_consume(1, now + 100000000));
+    EXPECT_FALSE(bucket.try_consume(1, now + 100000000));
+}
+
+TEST(TokenBucketTest, ConsumeReportsDelayForDebt) {
+    TokenBucket bucket;
+    bucket.configure(1000, 1000);
+    int64_t now = RateLimiter::now_ns();
+
+    EXPECT_EQ(bucket.consume(1000, now).count(), 0);
+    auto delay = bucket.consume(500, now);
+    EXPECT_NEAR(std::chrono::duration<double>(delay).count(), 0.5, 0.01);
+}
+
+TEST(TokenBucketTest, ConcurrentConsumersNeverOverdraw) {
+    TokenBucket bucket;
+    bucket.configure(1, 1000);
+    int64_t now = RateLimiter::now_ns();
+
+    std::atomic<int> granted{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 500; ++i) {
+                if (bucket.try_consume(1, now)) {
+                    granted++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(granted.load(), 1000);
+}
+
+TEST(RateLimiterTest, LimitsConcurrentConnections) {
+    RateLimiter::Config config;
+    config.max_connections = 2;
+    RateLimiter limiter(config);
+
+    auto first = limiter.open_connection("10.0.0.1");
+    auto second = limiter.open_connection("10.0.0.1");
+    auto third = limiter.open_connection("10.0.0.1");
+    EXPECT_TRUE(first);
+    EXPECT_TRUE(second);
+    EXPECT_FALSE(third);
+
+    // Other clients have their own budget
+    EXPECT_TRUE(limiter.open_connection("10.0.0.2"));
+
+    first = RateLimiter::Lease();
+    EXPECT_TRUE(limiter.open_connection("10.0.0.1"));
+}
+
+TEST(RateLimiterTest, LimitsRequestRate) {
+    RateLimiter::Config config;
+    config.requests_per_second = 3;
+    RateLimiter limiter(config);
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(limiter.open_connection("10.0.0.1"));
+    }
+    EXPECT_FALSE(limiter.open_connection("10.0.0.1"));
+}
+
+TEST(RateLimiterTest, EvictsIdleClients) {
+    RateLimiter::Config config;
+    config.max_connections = 10;
+    config.idle_timeout = std::chrono::seconds(0);
+    RateLimiter limiter(config);
+
+    auto active = limiter.open_connection("10.0.0.1");
+    limiter.open_connection("10.0.0.2");
+    limiter.evict_idle();
+
+    auto clients = limiter.snapshot();
+    ASSERT_EQ(clients.size(), 1);
+    EXPECT_EQ(clients[0].address, "10.0.0.1");
+    EXPECT_EQ(clients[0].connections, 1);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include "request_filter.hpp"
+#include "filter_stages.hpp"
+#include "header_rewriter.hpp"
+
+namespace {
+
+// Records the order stages ran in
+struct Trace {
+    std::string order;
+};
+
+struct AllowStage {
+    static constexpr const char* NAME = "allow";
+    Trace* trace;
+    FilterVerdict check(const RequestView&, FilterResult&) const {
+        trace->order += 'a';
+        return FilterVerdict::ALLOW;
+    }
+};
+
+struct DenyDeleteStage {
+    static constexpr const char* NAME = "deny_delete";
+    Trace* trace;
+    FilterVerdict check(const RequestView& request, FilterResult& result) const {
+        trace->order += 'd';
+        if (request.method == "DELETE") {
+            return result.deny("405 Method Not Allowed", "DELETE not allowed");
+        }
+        return FilterVerdict::ALLOW;
+    }
+};
+
+struct TagStage {
+    static constexpr const char* NAME = "tag";
+    Trace* trace;
+    FilterVerdict check(const RequestView& request, FilterResult& result) const {
+        trace->order += 't';
+        result.remove_field("Cookie");
+        return result.add_field("X-Client-Port", std::to_string(request.port));
+    }
+};
+
+constexpr std::string_view HEAD = "GET /index.html HTTP/1.1\r\n"
+                                  "Host: example.com:8080\r\n"
+                                  "Cookie: id=1\r\n"
+                                  "User-Agent:  curl/8.0 \r\n\r\n";
+
+RequestView view(std::string_view method = "GET", std::string_view target = "/index.html") {
+    return {method, target, "example.com:8080", "example.com", 8080, HEAD, "10.0.0.7"};
+}
+
+} // namespace
+
+TEST(RequestFilterTest, EmptyChainAllows) {
+    FilterChain<> chain;
+    FilterResult result = chain.run(view());
+    EXPECT_EQ(result.verdict, FilterVerdict::ALLOW);
+    EXPECT_EQ(FilterChain<>::STAGE_COUNT, 0u);
+}
+
+TEST(RequestFilterTest, RunsStagesInOrderAndStopsAtDenial) {
+    Trace trace;
+    FilterChain<AllowStage, DenyDeleteStage, TagStage> chain(AllowStage{&trace}, DenyDeleteStage{&trace},
+                                                             TagStage{&trace});
+
+    FilterResult result = chain.run(view("DELETE"));
+    EXPECT_EQ(trace.order, "ad");
+    EXPECT_EQ(result.verdict, FilterVerdict::DENY);
+    EXPECT_STREQ(result.status, "405 Method Not Allowed");
+    EXPECT_EQ(result.reason, "DELETE not allowed");
+    EXPECT_TRUE(result.added_fields.empty());
+
+    trace.order.clear();
+    result = chain.run(view());
+    EXPECT_EQ(trace.order, "adt");
+    EXPECT_EQ(result.verdict, FilterVerdict::MODIFY);
+    EXPECT_EQ(result.added_fields, "X-Client-Port: 8080\r\n");
+    ASSERT_EQ(result.removed_fields.size(), 1u);
+    EXPECT_EQ(result.removed_fields[0], "Cookie");
+}
+
+TEST(RequestFilterTest, ModificationsReachTheForwardedHead) {
+    Trace trace;
+    FilterChain<TagStage> chain(TagStage{&trace});
+    FilterResult result = chain.run(view());
+
+    HeaderRewriter rewriter;
+    HeaderRewriter::Options options;
+    options.added_fields = result.added_fields;
+    options.removed_fields = &result.removed_fields;
+    ASSERT_TRUE(rewriter.rewrite(HEAD, options));
+    std::string out;
+    for (const struct iovec& slice : rewriter.slices()) {
+        out.append(static_cast<const char*>(slice.iov_base), slice.iov_len);
+    }
+    EXPECT_EQ(out, "GET /index.html HTTP/1.1\r\n"
+                   "Host: example.com:8080\r\n"
+                   "User-Agent:  curl/8.0 \r\n"
+                   "X-Client-Port: 8080\r\n"
+                   "Connection: close\r\n"
+                   "Via: 1.1 cxx_proxy\r\n\r\n");
+}
+
+TEST(RequestFilterTest, ViewLooksUpHeaders) {
+    RequestView request = view();
+    EXPECT_EQ(request.header("user-agent"), "curl/8.0");
+    EXPECT_EQ(request.header("Host"), "example.com:8080");
+    EXPECT_EQ(request.header("Accept"), "");
+    EXPECT_EQ(request.header("Cookie: id"), "");
+    EXPECT_FALSE(request.is_connect());
+}
+
+TEST(RequestFilterTest, FilterManagerStages) {
+    FilterManager filter_manager;
+    filter_manager.set_blacklist_mode(true);
+    filter_manager.add_blacklist_entry("blocked.test");
+    ASSERT_TRUE(filter_manager.add_url_rule("/ads/"));
+    FilterChain<HostBlacklistStage, UrlRuleStage> chain{HostBlacklistStage(filter_manager),
+                                                        UrlRuleStage(filter_manager)};
+
+    RequestView allowed = view();
+    EXPECT_EQ(chain.run(allowed).verdict, FilterVerdict::ALLOW);
+
+    RequestView blocked_host = view();
+    blocked_host.authority = "blocked.test";
+    blocked_host.host = "blocked.test";
+    FilterResult result = chain.run(blocked_host);
+    EXPECT_EQ(result.verdict, FilterVerdict::DENY);
+    EXPECT_STREQ(result.status, "403 Forbidden");
+    EXPECT_EQ(result.reason, "host in blacklist: blocked.test");
+
+    EXPECT_EQ(chain.run(view("GET", "/ads/banner.png")).verdict, FilterVerdict::DENY);
+    EXPECT_EQ(chain.run(view("GET", "http://example.com/ads/x")).verdict, FilterVerdict::DENY);
+    // CONNECT targets carry no path for URL rules to match
+    EXPECT_EQ(chain.run(view("CONNECT", "example.com:443")).verdict, FilterVerdict::ALLOW);
+}
+
+TEST(RequestFilterTest, CountsPerStageInInstrumentedBuilds) {
+    Trace trace;
+    FilterChain<AllowStage, DenyDeleteStage> chain(AllowStage{&trace}, DenyDeleteStage{&trace});
+    chain.run(view());
+    chain.run(view("DELETE"));
+
+    std::vector<FilterStageStats> stats = chain.stats();
+    if (!decltype(chain)::INSTRUMENTED) {
+        EXPECT_TRUE(stats.empty());
+        return;
+    }
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_STREQ(stats[0].name, "allow");
+    EXPECT_EQ(stats[0].calls, 2u);
+    EXPECT_EQ(stats[0].denials, 0u);
+    EXPECT_STREQ(stats[1].name, "deny_delete");
+    EXPECT_EQ(stats[1].calls, 2u);
+    EXPECT_EQ(stats[1].denials, 1u);
+    EXPECT_EQ(stats[1].modifications, 0u);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "socket_handoff.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+int open_loopback_listener(int& port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    bind(listener, (struct sockaddr*)&addr, sizeof(addr));
+    listen(listener, 16);
+    getsockname(listener, (struct sockaddr*)&addr, &addr_len);
+    port = ntohs(addr.sin_port);
+    return listener;
+}
+
+int local_port(int socket) {
+    struct sockaddr_in addr = {};
+    socklen_t addr_len = sizeof(addr);
+    getsockname(socket, (struct sockaddr*)&addr, &addr_len);
+    return ntohs(addr.sin_port);
+}
+
+} // namespace
+
+TEST(SocketHandoffTest, PassesDescriptorOverSocketPair) {
+    int channel[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+
+    int port = 0;
+    int listener = open_loopback_listener(port);
+    ASSERT_TRUE(SocketHandoff::send_fd(channel[0], listener));
+
+    int received = SocketHandoff::receive_fd(channel[1]);
+    ASSERT_GE(received, 0);
+    EXPECT_NE(received, listener);
+    EXPECT_EQ(local_port(received), port);
+
+    close(received);
+    close(listener);
+    close(channel[0]);
+    close(channel[1]);
+}
+
+TEST(SocketHandoffTest, TakeOverWithoutRunningProcessFails) {
+    std::string path = (std::filesystem::temp_directory_path() / "test_handoff_missing.sock").string();
+    std::filesystem::remove(path);
+    SocketHandoff handoff(path);
+    EXPECT_EQ(handoff.take_over(), -1);
+}
+
+TEST(SocketHandoffTest, SuccessorTakesOverListener) {
+    std::string path = (std::filesystem::temp_directory_path() / "test_handoff.sock").string();
+    int port = 0;
+    int listener = open_loopback_listener(port);
+
+    std::atomic<bool> handed_off{false};
+    SocketHandoff old_process(path);
+    ASSERT_TRUE(old_process.serve(listener, [&handed_off] { handed_off = true; }));
+
+    SocketHandoff new_process(path);
+    int inherited = new_process.take_over();
+    ASSERT_GE(inherited, 0);
+    EXPECT_EQ(local_port(inherited), port);
+    EXPECT_FALSE(handed_off);
+
+    new_process.acknowledge();
+    for (int i = 0; i < 100 && !handed_off; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(handed_off);
+
+    close(inherited);
+    close(listener);
+    std::filesystem::remove(path);
+}
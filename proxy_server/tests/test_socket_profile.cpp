@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "socket_profile.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+namespace {
+
+int get_option(int socket, int level, int option) {
+    int value = 0;
+    socklen_t length = sizeof(value);
+    getsockopt(socket, level, option, &value, &length);
+    return value;
+}
+
+} // namespace
+
+TEST(SocketProfileTest, ParsesNamedProfiles) {
+    SocketProfile profile;
+    ASSERT_TRUE(SocketProfile::parse("default", profile));
+    EXPECT_FALSE(profile.no_delay);
+    EXPECT_EQ(profile.send_buffer, 0);
+
+    ASSERT_TRUE(SocketProfile::parse("latency", profile));
+    EXPECT_EQ(profile.name, "latency");
+    EXPECT_TRUE(profile.no_delay);
+    EXPECT_TRUE(profile.fast_open_connect);
+    EXPECT_GT(profile.busy_poll_us, 0);
+
+    ASSERT_TRUE(SocketProfile::parse("bulk", profile));
+    EXPECT_FALSE(profile.no_delay);
+    EXPECT_GT(profile.send_buffer, 0);
+    EXPECT_GT(profile.receive_buffer, 0);
+}
+
+TEST(SocketProfileTest, AppliesOverrides) {
+    SocketProfile profile;
+    ASSERT_TRUE(SocketProfile::parse("bulk,sndbuf=65536,nodelay=1,busy-poll=0", profile));
+    EXPECT_EQ(profile.send_buffer, 65536);
+    EXPECT_TRUE(profile.no_delay);
+    EXPECT_EQ(profile.busy_poll_us, 0);
+}
+
+TEST(SocketProfileTest, RejectsUnknownNamesAndKeys) {
+    SocketProfile profile;
+    EXPECT_FALSE(SocketProfile::parse("fast", profile));
+    EXPECT_FALSE(SocketProfile::parse("latency,colour=1", profile));
+    EXPECT_FALSE(SocketProfile::parse("latency,sndbuf", profile));
+    EXPECT_FALSE(SocketProfile::parse("latency,sndbuf=big", profile));
+    EXPECT_FALSE(SocketProfile::parse("latency,sndbuf=-1", profile));
+}
+
+TEST(SocketProfileTest, SetsOptionsOnSockets) {
+    SocketProfile profile;
+    ASSERT_TRUE(SocketProfile::parse("latency,sndbuf=65536,busy-poll=0", profile));
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    profile.apply_listener(listener);
+    EXPECT_GT(get_option(listener, IPPROTO_TCP, TCP_DEFER_ACCEPT), 0);
+    // The kernel doubles the requested size for bookkeeping
+    EXPECT_GE(get_option(listener, SOL_SOCKET, SO_SNDBUF), 65536);
+    close(listener);
+
+    int upstream = socket(AF_INET, SOCK_STREAM, 0);
+    profile.apply_upstream(upstream, true);
+    EXPECT_EQ(get_option(upstream, IPPROTO_TCP, TCP_NODELAY), 1);
+    EXPECT_EQ(get_option(upstream, IPPROTO_TCP, TCP_NOTSENT_LOWAT), profile.not_sent_lowat);
+    close(upstream);
+}
+
+TEST(SocketProfileTest, FastOpenConnectCanBeWithheld) {
+    SocketProfile profile;
+    ASSERT_TRUE(SocketProfile::parse("latency", profile));
+
+    int fast = socket(AF_INET, SOCK_STREAM, 0);
+    profile.apply_upstream(fast, true);
+    EXPECT_EQ(get_option(fast, IPPROTO_TCP, TCP_FASTOPEN_CONNECT), 1);
+    close(fast);
+
+    // Parents and CONNECT targets need connect() to mean a finished handshake
+    int checked = socket(AF_INET, SOCK_STREAM, 0);
+    profile.apply_upstream(checked, false);
+    EXPECT_EQ(get_option(checked, IPPROTO_TCP, TCP_FASTOPEN_CONNECT), 0);
+    EXPECT_EQ(get_option(checked, IPPROTO_TCP, TCP_NODELAY), 1);
+    close(checked);
+}
+
+TEST(SocketProfileTest, DefaultLeavesKernelSettings) {
+    SocketProfile profile;
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    profile.apply_client(client);
+    EXPECT_EQ(get_option(client, IPPROTO_TCP, TCP_NODELAY), 0);
+    close(client);
+}
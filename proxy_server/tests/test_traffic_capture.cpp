@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "traffic_capture.hpp"
+#include <filesystem>
+
+namespace {
+
+std::string capture_path(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+TrafficCapture::Record make_record(uint64_t offset_ns, const std::string& host) {
+    TrafficCapture::Record record;
+    record.offset_ns = offset_ns;
+    record.request_bytes = 120;
+    record.response_bytes = 4096;
+    record.duration_us = 1500;
+    record.port = 8080;
+    record.host = host;
+    record.head = "GET http://" + host + ":8080/ HTTP/1.1\r\nHost: " + host + ":8080\r\n\r\n";
+    return record;
+}
+
+} // namespace
+
+TEST(TrafficCaptureTest, RoundTripsRecordsInArrivalOrder) {
+    std::string path = capture_path("test_capture_roundtrip.bin");
+    {
+        TrafficCapture capture(path, 1.0);
+        ASSERT_TRUE(capture.is_open());
+        // Completion order differs from arrival order
+        capture.record(make_record(2000, "b.example"));
+        capture.record(make_record(1000, "a.example"));
+    }
+
+    std::vector<TrafficCapture::Record> records;
+    ASSERT_TRUE(TrafficCapture::read_all(path, records));
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].offset_ns, 1000u);
+    EXPECT_EQ(records[0].host, "a.example");
+    EXPECT_EQ(records[0].port, 8080);
+    EXPECT_EQ(records[0].response_bytes, 4096u);
+    EXPECT_EQ(records[0].duration_us, 1500u);
+    EXPECT_EQ(records[0].head, make_record(1000, "a.example").head);
+    EXPECT_EQ(records[1].host, "b.example");
+
+    std::filesystem::remove(path);
+}
+
+TEST(TrafficCaptureTest, SampleRateBounds) {
+    std::string path = capture_path("test_capture_sampling.bin");
+    TrafficCapture always(path, 1.0);
+    TrafficCapture never(path, 0.0);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(always.should_sample());
+        EXPECT_FALSE(never.should_sample());
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(TrafficCaptureTest, IgnoresTornFinalRecord) {
+    std::string path = capture_path("test_capture_torn.bin");
+    {
+        TrafficCapture capture(path, 1.0);
+        capture.record(make_record(1000, "a.example"));
+        capture.record(make_record(2000, "b.example"));
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 5);
+
+    std::vector<TrafficCapture::Record> records;
+    ASSERT_TRUE(TrafficCapture::read_all(path, records));
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].host, "a.example");
+
+    std::filesystem::remove(path);
+}
+
+TEST(TrafficCaptureTest, RejectsForeignFile) {
+    std::string path = capture_path("test_capture_foreign.bin");
+    FILE* file = fopen(path.c_str(), "wb");
+    fputs("not a capture file", file);
+    fclose(file);
+
+    std::vector<TrafficCapture::Record> records;
+    EXPECT_FALSE(TrafficCapture::read_all(path, records));
+    std::filesystem::remove(path);
+}
+
+TEST(TrafficCaptureTest, KeepsDurationsPastUint32) {
+    std::string path = capture_path("test_capture_duration.bin");
+    TrafficCapture::Record record = make_record(1000, "a.example");
+    record.duration_us = 5000000000ull;  // about 83 minutes
+    {
+        TrafficCapture capture(path, 1.0);
+        capture.record(record);
+    }
+    // No padding between or after the fields
+    EXPECT_EQ(std::filesystem::file_size(path), sizeof(TrafficCapture::FileHeader) +
+              TrafficCapture::RECORD_HEADER_SIZE + record.host.size() + record.head.size());
+
+    std::vector<TrafficCapture::Record> records;
+    ASSERT_TRUE(TrafficCapture::read_all(path, records));
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].duration_us, 5000000000ull);
+    EXPECT_EQ(records[0].head, record.head);
+
+    std::filesystem::remove(path);
+}
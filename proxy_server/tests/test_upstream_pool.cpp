@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include "upstream_pool.hpp"
+#include <map>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string key(const UpstreamPool::Upstream& upstream) {
+    return upstream.host + ":" + std::to_string(upstream.port);
+}
+
+void eject(UpstreamPool& pool, size_t index) {
+    auto& upstream = pool.upstream(index);
+    for (int i = 0; i < UpstreamPool::EJECT_AFTER_FAILURES; ++i) {
+        pool.report_failure(upstream);
+    }
+}
+
+} // namespace
+
+TEST(UpstreamPoolTest, ParsePolicy) {
+    UpstreamPool::Policy policy;
+    EXPECT_TRUE(UpstreamPool::parse_policy("weighted", policy));
+    EXPECT_EQ(policy, UpstreamPool::Policy::WEIGHTED);
+    EXPECT_TRUE(UpstreamPool::parse_policy("least-conn", policy));
+    EXPECT_EQ(policy, UpstreamPool::Policy::LEAST_CONNECTIONS);
+    EXPECT_TRUE(UpstreamPool::parse_policy("hash", policy));
+    EXPECT_EQ(policy, UpstreamPool::Policy::CONSISTENT_HASH);
+    EXPECT_FALSE(UpstreamPool::parse_policy("random", policy));
+}
+
+TEST(UpstreamPoolTest, WeightedFollowsWeights) {
+    UpstreamPool pool(UpstreamPool::Policy::WEIGHTED);
+    pool.add_upstream("a", 1, 3);
+    pool.add_upstream("b", 1, 1);
+
+    std::map<std::string, int> picks;
+    for (int i = 0; i < 400; ++i) {
+        picks[pool.select("example.com")->host]++;
+    }
+    EXPECT_EQ(picks["a"], 300);
+    EXPECT_EQ(picks["b"], 100);
+}
+
+TEST(UpstreamPoolTest, LeastConnectionsPrefersIdle) {
+    UpstreamPool pool(UpstreamPool::Policy::LEAST_CONNECTIONS);
+    pool.add_upstream("a", 1);
+    pool.add_upstream("b", 1);
+
+    auto first = pool.select("x");
+    auto second = pool.select("x");
+    EXPECT_NE(first->host, second->host);
+    EXPECT_EQ(first->active_connections.load(), 1);
+
+    std::string freed = first->host;
+    first = UpstreamPool::Lease();
+    EXPECT_EQ(pool.select("x")->host, freed);
+}
+
+TEST(UpstreamPoolTest, ConsistentHashIsStableAndSpreads) {
+    UpstreamPool pool(UpstreamPool::Policy::CONSISTENT_HASH);
+    pool.add_upstream("a", 1);
+    pool.add_upstream("b", 1);
+    pool.add_upstream("c", 1);
+
+    std::map<std::string, std::string> assignment;
+    std::map<std::string, int> load;
+    for (int i = 0; i < 3000; ++i) {
+        std::string host = "host" + std::to_string(i) + ".example.com";
+        assignment[host] = key(*pool.select(host));
+        load[assignment[host]]++;
+    }
+    for (const auto& [upstream, count] : load) {
+        EXPECT_GT(count, 700) << upstream;
+        EXPECT_LT(count, 1300) << upstream;
+    }
+
+    for (const auto& [host, upstream] : assignment) {
+        EXPECT_EQ(key(*pool.select(host)), upstream);
+    }
+
+    // Ejecting one parent only moves the hosts it owned
+    eject(pool, 0);
+    std::string ejected = key(pool.upstream(0));
+    for (const auto& [host, upstream] : assignment) {
+        std::string now = key(*pool.select(host));
+        if (upstream == ejected) {
+            EXPECT_NE(now, ejected);
+        } else {
+            EXPECT_EQ(now, upstream);
+        }
+    }
+}
+
+TEST(UpstreamPoolTest, PassiveEjectionAndRecovery) {
+    UpstreamPool pool(UpstreamPool::Policy::WEIGHTED);
+    pool.add_upstream("a", 1);
+    pool.add_upstream("b", 1);
+
+    auto& a = pool.upstream(0);
+    for (int i = 0; i < UpstreamPool::EJECT_AFTER_FAILURES - 1; ++i) {
+        pool.report_failure(a);
+    }
+    EXPECT_TRUE(pool.is_healthy(a));
+    pool.report_failure(a);
+    EXPECT_FALSE(pool.is_healthy(a));
+
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(pool.select("x")->host, "b");
+    }
+
+    pool.report_success(a);
+    EXPECT_TRUE(pool.is_healthy(a));
+
+    eject(pool, 0);
+    eject(pool, 1);
+    EXPECT_FALSE(pool.select("x"));
+}
+
+TEST(UpstreamPoolTest, ActiveProbeEjectsUnreachable) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listener, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(bind(listener, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(listener, 16), 0);
+    ASSERT_EQ(getsockname(listener, (struct sockaddr*)&addr, &addr_len), 0);
+    int live_port = ntohs(addr.sin_port);
+
+    // Grab a port and release it so nothing listens there
+    int closed = socket(AF_INET, SOCK_STREAM, 0);
+    addr.sin_port = 0;
+    ASSERT_EQ(bind(closed, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(getsockname(closed, (struct sockaddr*)&addr, &addr_len), 0);
+    int dead_port = ntohs(addr.sin_port);
+    close(closed);
+
+    UpstreamPool pool(UpstreamPool::Policy::WEIGHTED);
+    pool.add_upstream("127.0.0.1", live_port);
+    pool.add_upstream("127.0.0.1", dead_port);
+    for (int i = 0; i < UpstreamPool::EJECT_AFTER_FAILURES; ++i) {
+        pool.probe_all();
+    }
+
+    EXPECT_TRUE(pool.is_healthy(pool.upstream(0)));
+    EXPECT_FALSE(pool.is_healthy(pool.upstream(1)));
+    close(listener);
+}
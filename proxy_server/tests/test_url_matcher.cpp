@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include "url_matcher.hpp"
+
+TEST(UrlMatcherTest, EmptyRuleSetMatchesNothing) {
+    UrlMatcher matcher({});
+    EXPECT_FALSE(matcher.matches("http://example.com/"));
+    EXPECT_FALSE(matcher.matches(""));
+}
+
+TEST(UrlMatcherTest, MatchesSubstringsAnywhere) {
+    UrlMatcher matcher({"/ads/", "tracker", "doubleclick.net"});
+    EXPECT_EQ(matcher.find("http://example.com/ads/banner.png"), 0);
+    EXPECT_EQ(matcher.find("http://example.com/js/tracker.min.js"), 1);
+    EXPECT_EQ(matcher.find("http://ad.doubleclick.net/x"), 2);
+    EXPECT_EQ(matcher.find("http://example.com/adsense/"), -1);
+    EXPECT_EQ(matcher.find("http://example.com/"), -1);
+}
+
+TEST(UrlMatcherTest, IgnoresCase) {
+    UrlMatcher matcher({"/Ads/"});
+    EXPECT_TRUE(matcher.matches("http://example.com/ADS/x"));
+    EXPECT_TRUE(matcher.matches("http://example.com/ads/x"));
+}
+
+TEST(UrlMatcherTest, FindsOverlappingAndNestedRules) {
+    // "she" only matches through the failure link from "hers"
+    UrlMatcher matcher({"hers", "she", "his"});
+    EXPECT_EQ(matcher.find("http://x/ushers"), 1);
+    EXPECT_EQ(matcher.find("http://x/hi-s"), -1);
+    EXPECT_EQ(matcher.find("http://x/this"), 2);
+
+    UrlMatcher nested({"abcd", "bc"});
+    EXPECT_EQ(nested.find("xabcx"), 1);
+}
+
+TEST(UrlMatcherTest, HonoursAnchors) {
+    UrlMatcher matcher({"|http://ads.", "tracker.js|", "|http://exact.com/|"});
+    EXPECT_TRUE(matcher.matches("http://ads.example.com/"));
+    EXPECT_FALSE(matcher.matches("http://example.com/?r=http://ads.x"));
+
+    EXPECT_TRUE(matcher.matches("http://example.com/tracker.js"));
+    EXPECT_FALSE(matcher.matches("http://example.com/tracker.js?v=2"));
+
+    EXPECT_TRUE(matcher.matches("http://exact.com/"));
+    EXPECT_FALSE(matcher.matches("http://exact.com/page"));
+}
+
+TEST(UrlMatcherTest, AnchoredRuleSharesStatesWithUnanchored) {
+    UrlMatcher matcher({"|ads", "ads|"});
+    EXPECT_TRUE(matcher.matches("ads.example.com/"));
+    EXPECT_TRUE(matcher.matches("example.com/ads"));
+    EXPECT_FALSE(matcher.matches("example.com/ads/x"));
+    EXPECT_EQ(matcher.rule(1), "ads|");
+}
+
+TEST(UrlMatcherTest, CompressesAlphabet) {
+    UrlMatcher matcher({"abc", "cab"});
+    // Three letters plus the shared class for every other byte
+    EXPECT_EQ(matcher.class_count(), 4u);
+    EXPECT_EQ(matcher.state_count(), 7u);
+    EXPECT_TRUE(matcher.matches(std::string("\xff\x00zzcab", 7)));
+}
+
+TEST(UrlMatcherTest, AgreesWithNaiveSearch) {
+    std::vector<std::string> rules = {"/a", "ab", "bab", "b/", "aaa", "/b/a"};
+    UrlMatcher matcher(rules);
+    const char alphabet[] = "ab/";
+    // Every string over the alphabet up to length 6
+    for (int length = 0; length <= 6; ++length) {
+        int total = 1;
+        for (int i = 0; i < length; ++i) {
+            total *= 3;
+        }
+        for (int n = 0; n < total; ++n) {
+            std::string url;
+            for (int i = 0, v = n; i < length; ++i, v /= 3) {
+                url += alphabet[v % 3];
+            }
+            bool expected = false;
+            for (const auto& rule : rules) {
+                expected = expected || url.find(rule) != std::string::npos;
+            }
+            EXPECT_EQ(matcher.matches(url), expected) << url;
+        }
+    }
+}
+
+TEST(UrlMatcherTest, MatchesAcrossPieces) {
+    UrlMatcher matcher({"|http://ads.", "example.com/x", "tracker.js|"});
+    const std::string url = "http://ads.example.com/x/tracker.js";
+    // Every split point, so rules and anchors straddle piece boundaries
+    for (size_t a = 0; a <= url.size(); ++a) {
+        for (size_t b = a; b <= url.size(); ++b) {
+            std::string_view whole(url);
+            std::string_view first = whole.substr(0, a), second = whole.substr(a, b - a), third = whole.substr(b);
+            EXPECT_EQ(matcher.find_concatenated({first, second, third}), matcher.find(url)) << a << " " << b;
+        }
+    }
+    EXPECT_EQ(matcher.find_concatenated({"x", "http://ads.", "y"}), -1);
+    EXPECT_EQ(matcher.rule(matcher.find_concatenated({"http://", "cdn.net", "/tracker.js"})), "tracker.js|");
+    EXPECT_EQ(matcher.find_concatenated({"http://", "cdn.net", "/tracker.js?v=1"}), -1);
+}
@@ -82,4 +82,15 @@ TEST_F(WebUITest, InvalidPort) {
     filter_manager = std::make_unique<FilterManager>();
     EXPECT_THROW(std::make_unique<WebUI>(0, *filter_manager), std::runtime_error);
     EXPECT_THROW(std::make_unique<WebUI>(70000, *filter_manager), std::runtime_error);
-} 
\ No newline at end of file
+} 
+TEST(WebUIStopTest, StopEndsStartAtAnyPoint) {
+    FilterManager filter_manager;
+    // Stop racing the listen call, then stop a server that is listening
+    for (int delay_ms : {0, 200}) {
+        WebUI web_ui(18095, filter_manager);
+        std::thread server([&web_ui] { web_ui.start(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        web_ui.stop();
+        server.join();
+    }
+}
@@ -0,0 +1,90 @@
+// Replays a traffic capture against a proxy pointed at a local synthetic
+// origin and reports throughput and latency, optionally against a baseline
+// build for comparison.
+//
+//   proxy_replay <capture> --proxy=<host:port> [--baseline=<host:port>]
+//                [--speed=<factor>] [--concurrency=<n>]
+
+#include "capture_replay.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void print_report(const std::string& name, const CaptureReplay::Report& report) {
+    std::cout << std::fixed << std::setprecision(2)
+              << name << ": " << report.requests << " requests, " << report.errors << " errors in "
+              << report.seconds << " s\n"
+              << "  throughput: " << report.requests_per_second() << " req/s, "
+              << report.megabytes_per_second() << " MB/s, " << report.body_bytes / 1e6 << " MB uploaded\n"
+              << "  latency ms: p50 " << report.percentile(0.50) << ", p90 " << report.percentile(0.90)
+              << ", p99 " << report.percentile(0.99) << ", max " << report.percentile(1.0) << "\n";
+}
+
+void print_delta(const char* label, double baseline, double candidate) {
+    double change = baseline != 0 ? (candidate - baseline) / baseline * 100 : 0;
+    std::cout << "  " << label << ": " << std::showpos << change << std::noshowpos << "%\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <capture> --proxy=<host:port> [--baseline=<host:port>]"
+                  << " [--speed=<factor>] [--concurrency=<n>]" << std::endl;
+        return 1;
+    }
+
+    CaptureReplay::Endpoint proxy, baseline;
+    bool has_proxy = false, has_baseline = false;
+    double speed = 1.0;
+    size_t concurrency = 64;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--proxy=", 0) == 0) {
+            has_proxy = CaptureReplay::parse_endpoint(arg.substr(8), proxy);
+        } else if (arg.rfind("--baseline=", 0) == 0) {
+            has_baseline = CaptureReplay::parse_endpoint(arg.substr(11), baseline);
+        } else if (arg.rfind("--speed=", 0) == 0) {
+            speed = std::max(std::stod(arg.substr(8)), 0.001);
+        } else if (arg.rfind("--concurrency=", 0) == 0) {
+            concurrency = std::max(std::stoul(arg.substr(14)), 1ul);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (!has_proxy) {
+        std::cerr << "Missing --proxy=<host:port>" << std::endl;
+        return 1;
+    }
+
+    std::vector<TrafficCapture::Record> records;
+    if (!TrafficCapture::read_all(argv[1], records)) {
+        std::cerr << "Cannot read capture: " << argv[1] << std::endl;
+        return 1;
+    }
+    size_t tunnels = std::count_if(records.begin(), records.end(), CaptureReplay::is_connect);
+    size_t replayable = std::count_if(records.begin(), records.end(), CaptureReplay::is_replayable);
+    std::cout << "Replaying " << replayable << " requests at " << speed << "x"
+              << " (" << tunnels << " CONNECT tunnels and " << records.size() - tunnels - replayable
+              << " chunked uploads skipped)\n";
+
+    if (has_baseline) {
+        CaptureReplay::Report base = CaptureReplay::run(records, baseline, speed, concurrency);
+        CaptureReplay::Report candidate = CaptureReplay::run(records, proxy, speed, concurrency);
+        print_report("baseline", base);
+        print_report("candidate", candidate);
+        std::cout << "candidate vs baseline:\n" << std::fixed << std::setprecision(1);
+        print_delta("throughput", base.requests_per_second(), candidate.requests_per_second());
+        print_delta("p50 latency", base.percentile(0.50), candidate.percentile(0.50));
+        print_delta("p99 latency", base.percentile(0.99), candidate.percentile(0.99));
+        print_delta("errors", static_cast<double>(base.errors), static_cast<double>(candidate.errors));
+    } else {
+        print_report("proxy", CaptureReplay::run(records, proxy, speed, concurrency));
+    }
+    return 0;
+}